@@ -0,0 +1,109 @@
+#include "EasyMPI.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <thread>
+#include <chrono>
+
+const int SLOW_PROCESS = 1; // process that is simulated to be slow
+const int SLOW_FACTOR = 4; // how many times slower it is
+const int COST_UNIT_MS = 20; // duration of one unit of task cost on a normal process
+
+void masterBenchmark();
+void slaveBenchmark();
+double runBatch(EasyMPI::MPISession& session, bool speedAware);
+
+/*!
+ * This benchmark simulates a cluster where one slave is SLOW_FACTOR times slower than the others. 
+ * It runs a batch of short tasks followed by a few long tasks, once with speed-aware scheduling 
+ * disabled and once enabled, and reports the makespan of both.
+ *
+ * Run with at least 3 processes, e.g. mpirun -np 4 ./EasyMPIBenchmark
+ */
+int main(int argc, char* argv[])
+{
+	EasyMPI::MPIScheduler::initialize(argc, argv);
+
+	if (EasyMPI::MPIScheduler::getNumProcesses() < 3)
+	{
+		std::cerr << "The benchmark needs at least 3 processes." << std::endl;
+		EasyMPI::MPIScheduler::finalize();
+		return 1;
+	}
+
+	if (EasyMPI::MPIScheduler::getProcessID() == 0)
+		masterBenchmark();
+	else
+		slaveBenchmark();
+
+	EasyMPI::MPIScheduler::finalize();
+
+	return 0;
+}
+
+void masterBenchmark()
+{
+	EasyMPI::MPISession session;
+
+	// warm up so the master learns the speed of every slave
+	std::vector<EasyMPI::Task> warmupList(4 * (EasyMPI::MPIScheduler::getNumProcesses() - 1), EasyMPI::Task("WORK", "1"));
+	session.scheduleTasks(warmupList);
+
+	double fifoMakespan = runBatch(session, false);
+	double speedAwareMakespan = runBatch(session, true);
+	session.close();
+
+	std::cerr << "Makespan with speed-unaware scheduling: " << fifoMakespan << " s" << std::endl;
+	std::cerr << "Makespan with speed-aware scheduling: " << speedAwareMakespan << " s" << std::endl;
+	EasyMPI::MPIScheduler::printStatistics(std::cerr);
+}
+
+double runBatch(EasyMPI::MPISession& session, bool speedAware)
+{
+	const int numSlaves = EasyMPI::MPIScheduler::getNumProcesses() - 1;
+	const int SHORT_TASKS_PER_SLAVE = 8;
+	const int SHORT_COST = 1;
+	const int LONG_COST = 6;
+
+	EasyMPI::MPIScheduler::setSpeedAwareScheduling(speedAware);
+
+	// short tasks first, then one long task per slave
+	for (int i = 0; i < SHORT_TASKS_PER_SLAVE * numSlaves; i++)
+	{
+		session.submit(EasyMPI::Task("WORK", "1"), EasyMPI::TaskQueues::DEFAULT_CLASS, SHORT_COST);
+	}
+	for (int i = 0; i < numSlaves; i++)
+	{
+		std::stringstream ss;
+		ss << LONG_COST;
+		session.submit(EasyMPI::Task("WORK", ss.str()), EasyMPI::TaskQueues::DEFAULT_CLASS, LONG_COST);
+	}
+
+	double startTime = MPI_Wtime();
+	session.scheduleTasks();
+	return MPI_Wtime() - startTime;
+}
+
+void slaveBenchmark()
+{
+	const int slowdown = EasyMPI::MPIScheduler::getProcessID() == SLOW_PROCESS ? SLOW_FACTOR : 1;
+
+	while (true)
+	{
+		EasyMPI::Task task = EasyMPI::MPIScheduler::slaveWaitForTasks();
+
+		if (task.getCommand().compare("WORK") == 0)
+		{
+			// simulate work proportional to the cost
+			int cost = atoi(task.getParameters().c_str());
+			std::this_thread::sleep_for(std::chrono::milliseconds(cost * COST_UNIT_MS * slowdown));
+
+			EasyMPI::MPIScheduler::slaveFinishedTask();
+		}
+		else if (task.getCommand().compare(EasyMPI::MPIScheduler::MASTER_FINISH_COMMAND) == 0)
+		{
+			break;
+		}
+	}
+}
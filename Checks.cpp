@@ -0,0 +1,774 @@
+#include "EasyMPI.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <cstdlib>
+#include <fstream>
+#include <cstdio>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <algorithm>
+
+const int ELASTIC_TASK_MS = 10; // duration of a task of the elastic check
+const int ELASTIC_LONG_TASK_MS = 1500; // duration of the task that drains a batch of the elastic check (spawning takes a while)
+const int CANCELLABLE_TASK_MS = 2000; // duration of a task of the cancellation check unless it is cancelled
+
+bool checkSession();
+bool checkReduction();
+bool checkCompression();
+bool checkSharedData();
+bool checkParallelFor();
+bool checkPriorities();
+bool checkWorkerInfo();
+bool checkFileRegions();
+bool checkOrderedOutput();
+bool checkCancellation();
+bool checkResultCache();
+bool checkAffinity();
+bool checkPipeline();
+bool checkElastic();
+void slaveChecks();
+bool expect(bool condition, const std::string& description);
+void sumCombine(const double* in, double* inout, int length);
+
+/*!
+ * These checks run the features of EasyMPI and assert on their results.
+ * The program exits with 1 if any check failed.
+ *
+ * Every check is called on every process. The master runs a session and closes it,
+ * the slaves run slaveChecks() until the master finishes them. A single process 
+ * runs slaveChecks() on threads and skips the pipeline and elastic checks.
+ *
+ * Run e.g. with mpirun -np 3 ./EasyMPIChecks (the pipeline check uses two stages from 4 processes on)
+ */
+int main(int argc, char* argv[])
+{
+#ifdef __linux__
+	// bind every process and slave thread, unless a policy was given
+	setenv(EasyMPI::MPIScheduler::AFFINITY_VARIABLE.c_str(), "compact", 0);
+#endif
+	EasyMPI::MPIScheduler::initialize(argc, argv);
+	EasyMPI::MPIScheduler::setSlaveFunction(slaveChecks);
+
+	// every process, spawned ones included, folds (number of tasks, sum of task numbers)
+	EasyMPI::MPIScheduler::setReduction(std::vector<double>(2, 0.0), sumCombine);
+
+	// spawned workers only run the slave loop
+	if (EasyMPI::MPIScheduler::isSpawnedWorker())
+	{
+		slaveChecks();
+		EasyMPI::MPIScheduler::finalize();
+		return 0;
+	}
+
+	bool passed = true;
+	passed = checkSession() && passed;
+	passed = checkReduction() && passed;
+	passed = checkCompression() && passed;
+	passed = checkSharedData() && passed;
+	passed = checkParallelFor() && passed;
+	passed = checkPriorities() && passed;
+	passed = checkWorkerInfo() && passed;
+	passed = checkFileRegions() && passed;
+	passed = checkOrderedOutput() && passed;
+	passed = checkCancellation() && passed;
+	passed = checkResultCache() && passed;
+	passed = checkAffinity() && passed;
+	if (EasyMPI::MPIScheduler::getNumProcesses() > 1)
+	{
+		passed = checkPipeline() && passed;
+		passed = checkElastic() && passed;
+	}
+
+	if (EasyMPI::MPIScheduler::getProcessID() == 0)
+		std::cerr << (passed ? "All checks passed." : "Some checks FAILED!") << std::endl;
+
+	EasyMPI::MPIScheduler::finalize();
+
+	return passed ? 0 : 1;
+}
+
+/*!
+ * Print the outcome of one assertion on the master.
+ */
+bool expect(bool condition, const std::string& description)
+{
+	std::cerr << (condition ? "passed: " : "FAILED: ") << description << std::endl;
+	return condition;
+}
+
+/*!
+ * Combine function of the reduction: element-wise sum.
+ */
+void sumCombine(const double* in, double* inout, int length)
+{
+	for (int i = 0; i < length; i++)
+		inout[i] += in[i];
+}
+
+/*!
+ * Tasks made of a number, which the slaves count and sum.
+ */
+std::vector<EasyMPI::Task> numberedTasks(const std::string& command, int numTasks)
+{
+	std::vector<EasyMPI::Task> taskList;
+	for (int i = 0; i < numTasks; i++)
+	{
+		std::stringstream ss;
+		ss << i;
+		taskList.push_back(EasyMPI::Task(command, ss.str()));
+	}
+	return taskList;
+}
+
+bool extraTaskSubmitted = false; // whether the session check submitted its extra task
+std::vector<int> finishedTaskIDs; // task IDs in the order they finished
+int numFinishedTasks = 0; // callbacks of the current batch
+int cachedTaskToCancel = -1; // task the result cache check cancels from its callback (-1 if none)
+bool cachedTaskCancelled = false; // what cancel() returned for it
+std::atomic<long long> rangeCount(0); // indices processed by this process in the parallelFor check
+std::atomic<long long> rangeSum(0); // sum of those indices
+long long itemCount = 0; // items this process consumed in the last stage of the pipeline check
+long long itemSum = 0; // sum of those items
+
+/*!
+ * Task finished callback of the session check: submits one more task into the running batch.
+ */
+void submitExtraTask(EasyMPI::MPISession& session, int, const EasyMPI::Task&)
+{
+	if (extraTaskSubmitted)
+		return;
+	extraTaskSubmitted = true;
+	session.submit(EasyMPI::Task("NUMBER", "100"));
+}
+
+/*!
+ * Task finished callback of the priority check: records the finishing order.
+ */
+void recordFinishOrder(EasyMPI::MPISession&, int taskID, const EasyMPI::Task&)
+{
+	finishedTaskIDs.push_back(taskID);
+}
+
+/*!
+ * Task finished callback of the cancellation check: the first result cancels the rest.
+ */
+void cancelRemainingTasks(EasyMPI::MPISession& session, int, const EasyMPI::Task&)
+{
+	numFinishedTasks++;
+	session.cancelAll();
+}
+
+/*!
+ * Task finished callback of the result cache check: cancels a task still in the cache queue.
+ */
+void cancelCachedTask(EasyMPI::MPISession& session, int, const EasyMPI::Task&)
+{
+	numFinishedTasks++;
+	if (cachedTaskToCancel < 0)
+		return;
+	cachedTaskCancelled = session.cancel(cachedTaskToCancel);
+	cachedTaskToCancel = -1;
+}
+
+/*!
+ * Range function of the parallelFor check.
+ */
+void sumRange(long long begin, long long end)
+{
+	for (long long i = begin; i < end; i++)
+	{
+		rangeCount++;
+		rangeSum += i;
+	}
+}
+
+/*!
+ * First stage of a two-stage pipeline check: doubles the item.
+ */
+void doubleItem(EasyMPI::MPIPipeline& pipeline, const std::string& item)
+{
+	std::stringstream ss;
+	ss << 2 * atoll(item.c_str());
+	pipeline.emit(ss.str());
+}
+
+/*!
+ * Last stage of the pipeline check: counts and sums the items.
+ */
+void sumItem(EasyMPI::MPIPipeline&, const std::string& item)
+{
+	itemCount++;
+	itemSum += atoll(item.c_str());
+}
+
+/*!
+ * Sum of the bytes of the shared data of the checks.
+ */
+double sharedDataChecksum(const std::string& data)
+{
+	double checksum = 0;
+	for (size_t i = 0; i < data.size(); i++)
+		checksum += (unsigned char)data[i];
+	return checksum;
+}
+
+/*!
+ * Batches of a session reduce their own tasks only, the epoch counts the batches, 
+ * and a task submitted from the callback joins the running batch.
+ */
+bool checkSession()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		return true;
+	}
+
+	bool passed = true;
+	EasyMPI::MPISession session;
+
+	session.scheduleTasks(numberedTasks("NUMBER", 10));
+	std::vector<double> result = EasyMPI::MPIScheduler::getReducedResult();
+	passed = expect(result[0] == 10 && result[1] == 45, "session batch reduces every task once") && passed;
+
+	session.setTaskFinishedCallback(submitExtraTask);
+	session.scheduleTasks(numberedTasks("NUMBER", 20));
+	result = EasyMPI::MPIScheduler::getReducedResult();
+	passed = expect(result[0] == 21 && result[1] == 190 + 100, "task submitted from the callback joins the batch") && passed;
+	passed = expect(session.getEpoch() == 2, "session counts its batches") && passed;
+
+	session.close();
+
+	return passed;
+}
+
+/*!
+ * masterScheduleTasks() reduces the partial results of a single batch.
+ */
+bool checkReduction()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		return true;
+	}
+
+	EasyMPI::MPIScheduler::masterScheduleTasks(numberedTasks("NUMBER", 100));
+	std::vector<double> result = EasyMPI::MPIScheduler::getReducedResult();
+	return expect(result[0] == 100 && result[1] == 4950, "masterScheduleTasks reduces every task once");
+}
+
+/*!
+ * Compressed payloads decompress to the original, and repetitive data shrinks.
+ */
+bool checkCompression()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+		return true;
+
+	std::string data;
+	for (int i = 0; i < 10000; i++)
+	{
+		std::stringstream ss;
+		ss << "row " << i % 100 << "\n";
+		data += ss.str();
+	}
+
+	std::vector<char> encoded;
+	EasyMPI::CompressionTools::compress(data.data(), data.size(), encoded);
+	std::string decoded(data.size(), '\0');
+	bool roundTrip = EasyMPI::CompressionTools::decompress(&encoded[0], encoded.size(), &decoded[0], decoded.size());
+
+	bool passed = expect(roundTrip && decoded == data, "compression round trip restores the data");
+	passed = expect(encoded.size() < data.size() / 4, "compression shrinks repetitive data") && passed;
+
+	return passed;
+}
+
+/*!
+ * Slaves see the published data, compressed above the threshold, and the bytes 
+ * a republish changed.
+ */
+bool checkSharedData()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		return true;
+	}
+
+	EasyMPI::MPIScheduler::setCompressionThreshold(1024);
+
+	std::string data;
+	for (int i = 0; i < 20000; i++)
+	{
+		std::stringstream ss;
+		ss << "entry " << i % 500 << "\n";
+		data += ss.str();
+	}
+
+	bool passed = true;
+	EasyMPI::MPISession session;
+
+	EasyMPI::MPIScheduler::masterPublishData("CHECK_TABLE", data);
+	session.scheduleTasks(numberedTasks("SHARED", 10));
+	std::vector<double> result = EasyMPI::MPIScheduler::getReducedResult();
+	passed = expect(result[0] == 10 && result[1] == 10 * sharedDataChecksum(data), "slaves see the published data") && passed;
+
+	// only the changed bytes are sent
+	for (size_t i = data.size() / 2; i < data.size() / 2 + 100; i++)
+		data[i] = 'x';
+	EasyMPI::MPIScheduler::masterPublishData("CHECK_TABLE", data);
+	session.scheduleTasks(numberedTasks("SHARED", 10));
+	result = EasyMPI::MPIScheduler::getReducedResult();
+	passed = expect(result[0] == 10 && result[1] == 10 * sharedDataChecksum(data), "slaves see the republished data") && passed;
+
+	session.close();
+	EasyMPI::MPIScheduler::setCompressionThreshold(64 * 1024);
+
+	return passed;
+}
+
+/*!
+ * parallelFor() processes every index exactly once.
+ */
+bool checkParallelFor()
+{
+	const long long NUM_INDICES = 100000;
+	EasyMPI::MPIScheduler::parallelFor(0, NUM_INDICES, 0, sumRange);
+
+	long long local[2] = { rangeCount, rangeSum };
+	long long total[2];
+	MPI_Allreduce(local, total, 2, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+		return true;
+
+	return expect(total[0] == NUM_INDICES && total[1] == NUM_INDICES * (NUM_INDICES - 1) / 2, "parallelFor processes every index once");
+}
+
+/*!
+ * Tasks of a higher priority class overtake the waiting tasks of a lower one.
+ */
+bool checkPriorities()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		return true;
+	}
+
+	const int NUM_TASKS = 8; // per class
+
+	EasyMPI::MPISession session;
+	session.addTaskClass("urgent", 10);
+	session.setTaskFinishedCallback(recordFinishOrder);
+
+	std::vector<EasyMPI::Task> taskList = numberedTasks("SLEEP", NUM_TASKS);
+	for (int i = 0; i < NUM_TASKS; i++)
+		session.submit(taskList[i]);
+	std::vector<int> urgentIDs;
+	for (int i = 0; i < NUM_TASKS; i++)
+		urgentIDs.push_back(session.submit(taskList[i], "urgent"));
+	session.scheduleTasks();
+	session.close();
+
+	// only the tasks the workers started before the urgent ones were queued may finish earlier
+	const size_t lastPosition = NUM_TASKS + EasyMPI::MPIScheduler::getNumWorkers();
+	bool urgentFirst = finishedTaskIDs.size() == 2 * NUM_TASKS;
+	for (size_t i = 0; i < urgentIDs.size(); i++)
+	{
+		size_t position = std::find(finishedTaskIDs.begin(), finishedTaskIDs.end(), urgentIDs[i]) - finishedTaskIDs.begin();
+		urgentFirst = urgentFirst && position < lastPosition;
+	}
+
+	return expect(urgentFirst, "urgent task class overtakes the default class");
+}
+
+/*!
+ * Every worker reports its finished tasks and its measured speed, 
+ * and speed-aware scheduling still runs every task once.
+ */
+bool checkWorkerInfo()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		return true;
+	}
+
+	// slave threads are only workers while a session is open
+	EasyMPI::MPISession session;
+	std::vector<int> workerIDs = EasyMPI::MPIScheduler::getWorkerIDs();
+	int numTasksBefore = 0;
+	for (size_t i = 0; i < workerIDs.size(); i++)
+		numTasksBefore += EasyMPI::MPIScheduler::getWorkerInfo(workerIDs[i]).numTasks;
+
+	EasyMPI::MPIScheduler::setSpeedAwareScheduling(true);
+	session.scheduleTasks(numberedTasks("SLEEP", 20));
+	EasyMPI::MPIScheduler::setSpeedAwareScheduling(false);
+	std::vector<double> result = EasyMPI::MPIScheduler::getReducedResult();
+	bool passed = expect(result[0] == 20 && result[1] == 190, "speed-aware scheduling reduces every task once");
+
+	int numTasksAfter = 0;
+	bool measured = true;
+	for (size_t i = 0; i < workerIDs.size(); i++)
+	{
+		EasyMPI::WorkerInfo worker = EasyMPI::MPIScheduler::getWorkerInfo(workerIDs[i]);
+		numTasksAfter += worker.numTasks;
+		measured = measured && worker.cores > 0 && (worker.numTasks == 0 || worker.taskSpeed > 0);
+	}
+	passed = expect(numTasksAfter - numTasksBefore == 20, "workers count their finished tasks") && passed;
+	passed = expect(measured, "workers report cores and a measured speed") && passed;
+
+	session.close();
+
+	return passed;
+}
+
+/*!
+ * The regions of a split file cover every record exactly once.
+ */
+bool checkFileRegions()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		return true;
+	}
+
+	const int NUM_RECORDS = 10000;
+	const std::string path = "EasyMPIChecks.records";
+	{
+		std::ofstream out(path.c_str());
+		for (int i = 0; i < NUM_RECORDS; i++)
+			out << i << "\n";
+	}
+
+	EasyMPI::MPIScheduler::masterScheduleTasks(EasyMPI::MPIScheduler::masterSplitFile("REGION", path, 4096));
+	std::vector<double> result = EasyMPI::MPIScheduler::getReducedResult();
+	remove(path.c_str());
+
+	return expect(result[0] == NUM_RECORDS && result[1] == (double)NUM_RECORDS * (NUM_RECORDS - 1) / 2, "file regions cover every record once");
+}
+
+/*!
+ * Results end up in the file in task order, across batches.
+ */
+bool checkOrderedOutput()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		return true;
+	}
+
+	const std::string path = "EasyMPIChecks.out";
+	EasyMPI::MPIScheduler::setOrderedOutput(path);
+
+	EasyMPI::MPISession session;
+	session.scheduleTasks(numberedTasks("WRITE", 30));
+	session.scheduleTasks(numberedTasks("WRITE", 5));
+	session.close();
+	EasyMPI::MPIScheduler::setOrderedOutput("");
+
+	// task n writes n % 3 + 1 lines
+	std::stringstream expected;
+	for (int i = 0; i < 35; i++)
+	{
+		int number = i < 30 ? i : i - 30;
+		for (int line = 0; line <= number % 3; line++)
+			expected << number << "." << line << "\n";
+	}
+
+	std::ifstream in(path.c_str(), std::ios::binary);
+	std::stringstream written;
+	written << in.rdbuf();
+	in.close();
+	remove(path.c_str());
+
+	return expect(written.str() == expected.str(), "ordered output writes results in task order");
+}
+
+/*!
+ * Cancelled tasks stop early and their partial results are not reduced.
+ */
+bool checkCancellation()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		return true;
+	}
+
+	// the quick task finishes first and cancels the long ones
+	std::vector<EasyMPI::Task> taskList = numberedTasks("CANCELLABLE", 10);
+	taskList[0] = EasyMPI::Task("NUMBER", "0");
+
+	EasyMPI::MPISession session;
+	session.setTaskFinishedCallback(cancelRemainingTasks);
+	numFinishedTasks = 0;
+	double start = MPI_Wtime();
+	session.scheduleTasks(taskList);
+	double elapsed = MPI_Wtime() - start;
+	std::vector<double> result = EasyMPI::MPIScheduler::getReducedResult();
+	session.close();
+
+	bool passed = expect(numFinishedTasks == 1, "cancelled tasks do not finish");
+	passed = expect(elapsed < CANCELLABLE_TASK_MS / 2000.0, "running tasks stop when cancelled") && passed;
+	passed = expect(result[0] == 1 && result[1] == 0, "cancelled tasks are not reduced") && passed;
+
+	return passed;
+}
+
+/*!
+ * A repeated batch is served from the result cache without running a task, 
+ * and a task still waiting in the cache queue can be cancelled.
+ */
+bool checkResultCache()
+{
+	const std::string directory = "EasyMPIChecks.cache";
+	EasyMPI::MPIScheduler::setResultCache(directory, 1 << 20);
+
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		EasyMPI::MPIScheduler::setResultCache("");
+		return true;
+	}
+
+	// tasks are new to the cache on every run
+	const long long nonce = std::chrono::system_clock::now().time_since_epoch().count();
+	std::vector<EasyMPI::Task> taskList;
+	for (int i = 0; i < 20; i++)
+	{
+		std::stringstream ss;
+		ss << i << " " << nonce;
+		taskList.push_back(EasyMPI::Task("CACHED", ss.str()));
+	}
+
+	EasyMPI::MPISession session;
+	session.scheduleTasks(taskList);
+	std::vector<double> result = EasyMPI::MPIScheduler::getReducedResult();
+	bool passed = expect(result[0] == 20 && result[1] == 190, "result cache batch reduces every task once");
+
+	std::vector<int> workerIDs = EasyMPI::MPIScheduler::getWorkerIDs();
+	int numTasksBefore = 0;
+	for (size_t i = 0; i < workerIDs.size(); i++)
+		numTasksBefore += EasyMPI::MPIScheduler::getWorkerInfo(workerIDs[i]).numTasks;
+
+	session.scheduleTasks(taskList);
+	result = EasyMPI::MPIScheduler::getReducedResult();
+	passed = expect(result[0] == 20 && result[1] == 190, "cached batch reduces every task once") && passed;
+
+	int numTasksAfter = 0;
+	for (size_t i = 0; i < workerIDs.size(); i++)
+		numTasksAfter += EasyMPI::MPIScheduler::getWorkerInfo(workerIDs[i]).numTasks;
+	passed = expect(numTasksAfter == numTasksBefore, "cached batch runs no task") && passed;
+
+	// the first cached result cancels the last task, which is still in the cache queue
+	session.setTaskFinishedCallback(cancelCachedTask);
+	numFinishedTasks = 0;
+	for (size_t i = 0; i < taskList.size(); i++)
+		cachedTaskToCancel = session.submit(taskList[i]);
+	session.scheduleTasks();
+	result = EasyMPI::MPIScheduler::getReducedResult();
+	passed = expect(cachedTaskCancelled && numFinishedTasks == 19, "cancelling a cached task drops it") && passed;
+	passed = expect(result[0] == 19 && result[1] == 190 - 19, "cancelled cached task is not reduced") && passed;
+
+	session.close();
+	EasyMPI::MPIScheduler::setResultCache("");
+
+	return passed;
+}
+
+/*!
+ * With an affinity policy every process and slave thread is bound.
+ */
+bool checkAffinity()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+		return true;
+
+#ifdef __linux__
+	const char* policy = getenv(EasyMPI::MPIScheduler::AFFINITY_VARIABLE.c_str());
+	if (policy == NULL || std::string(policy).compare("compact") != 0)
+		return true;
+
+	bool bound = EasyMPI::MPIScheduler::getWorkerInfo(0).binding.compare("none") != 0;
+	std::vector<int> workerIDs = EasyMPI::MPIScheduler::getWorkerIDs();
+	for (size_t i = 0; i < workerIDs.size(); i++)
+		bound = bound && EasyMPI::MPIScheduler::getWorkerInfo(workerIDs[i]).binding.compare("none") != 0;
+
+	return expect(bound, "compact affinity binds every worker");
+#else
+	return true;
+#endif
+}
+
+/*!
+ * Every item passes every stage of the pipeline exactly once.
+ */
+bool checkPipeline()
+{
+	const int numProcesses = EasyMPI::MPIScheduler::getNumProcesses();
+	const int NUM_ITEMS = 200;
+
+	std::vector<int> stageSizes;
+	if (numProcesses >= 4)
+	{
+		stageSizes.push_back(2);
+		stageSizes.push_back(numProcesses - 2);
+	}
+	else
+		stageSizes.push_back(numProcesses);
+
+	EasyMPI::MPIPipeline pipeline(stageSizes);
+	if (stageSizes.size() > 1)
+		pipeline.setStageFunction(0, doubleItem);
+	pipeline.setStageFunction(stageSizes.size() - 1, sumItem);
+	if (EasyMPI::MPIScheduler::getProcessID() == 0)
+	{
+		for (int i = 0; i < NUM_ITEMS; i++)
+		{
+			std::stringstream ss;
+			ss << i;
+			pipeline.submit(ss.str());
+		}
+	}
+	pipeline.run();
+
+	long long local[2] = { itemCount, itemSum };
+	long long total[2];
+	MPI_Allreduce(local, total, 2, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+		return true;
+
+	const long long factor = stageSizes.size() > 1 ? 2 : 1;
+	return expect(total[0] == NUM_ITEMS && total[1] == factor * NUM_ITEMS * (NUM_ITEMS - 1) / 2, "pipeline passes every item through every stage once");
+}
+
+int maxNumWorkers = 0; // largest worker pool seen by the elastic check
+
+/*!
+ * Task finished callback of the elastic check: records the size of the worker pool.
+ */
+void recordNumWorkers(EasyMPI::MPISession&, int, const EasyMPI::Task&)
+{
+	maxNumWorkers = std::max(maxNumWorkers, EasyMPI::MPIScheduler::getNumWorkers());
+}
+
+/*!
+ * A backlog spawns workers; once a batch ended, a group that was idle for retireIdleSeconds
+ * is retired before the next batch, and a group idle while the batch drains is retired
+ * during the batch.
+ */
+bool checkElastic()
+{
+	if (EasyMPI::MPIScheduler::getProcessID() != 0)
+	{
+		slaveChecks();
+		return true;
+	}
+
+	const int numStarted = EasyMPI::MPIScheduler::getNumProcesses() - 1;
+	const double RETIRE_IDLE_SECONDS = 0.2;
+	EasyMPI::MPIScheduler::setElasticScaling(2, 1, 2.0, 0.0, RETIRE_IDLE_SECONDS);
+
+	bool passed = true;
+	EasyMPI::MPISession session;
+	session.setTaskFinishedCallback(recordNumWorkers);
+
+	// grow during a backlog
+	session.scheduleTasks(numberedTasks("SLEEP", 40));
+	std::vector<double> result = EasyMPI::MPIScheduler::getReducedResult();
+	passed = expect(result[0] == 40 && result[1] == 780, "elastic batch reduces every task once") && passed;
+	passed = expect(maxNumWorkers > numStarted, "elastic backlog spawns workers") && passed;
+
+	// idle between batches: retired before the next one starts
+	std::this_thread::sleep_for(std::chrono::duration<double>(2 * RETIRE_IDLE_SECONDS));
+	maxNumWorkers = 0;
+	session.scheduleTasks(numberedTasks("SLEEP", 1));
+	passed = expect(maxNumWorkers == numStarted, "elastic group idle between batches is retired") && passed;
+
+	// idle while a long task drains the batch: retired during the batch
+	std::vector<EasyMPI::Task> taskList = numberedTasks("SLEEP", 40);
+	taskList[0] = EasyMPI::Task("LONG_SLEEP", "0");
+	session.scheduleTasks(taskList);
+	passed = expect(EasyMPI::MPIScheduler::getNumWorkers() == numStarted, "elastic group idle while the batch drains is retired") && passed;
+
+	session.close();
+	EasyMPI::MPIScheduler::setElasticScaling(0);
+
+	return passed;
+}
+
+/*!
+ * Slave loop of all checks.
+ */
+void slaveChecks()
+{
+	while (true)
+	{
+		EasyMPI::Task task = EasyMPI::MPIScheduler::slaveWaitForTasks();
+		const std::string command = task.getCommand();
+		if (command.compare(EasyMPI::MPIScheduler::MASTER_FINISH_COMMAND) == 0)
+			break;
+		if (command.compare(EasyMPI::MPIScheduler::MASTER_BATCH_FINISH_COMMAND) == 0)
+			continue;
+
+		// every task but a region counts as one task with its number
+		const int number = atoi(task.getParameters().c_str());
+		std::vector<double> partialResult(2);
+		partialResult[0] = 1;
+		partialResult[1] = number;
+
+		if (command.compare("SLEEP") == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(ELASTIC_TASK_MS));
+		else if (command.compare("LONG_SLEEP") == 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(ELASTIC_LONG_TASK_MS));
+		else if (command.compare("SHARED") == 0)
+			partialResult[1] = sharedDataChecksum(EasyMPI::MPIScheduler::getSharedData("CHECK_TABLE"));
+		else if (command.compare("WRITE") == 0)
+		{
+			for (int line = 0; line <= number % 3; line++)
+			{
+				std::stringstream ss;
+				ss << number << "." << line << "\n";
+				EasyMPI::MPIScheduler::slaveWriteResult(ss.str());
+			}
+		}
+		else if (command.compare("CANCELLABLE") == 0)
+		{
+			for (int ms = 0; ms < CANCELLABLE_TASK_MS && !EasyMPI::MPIScheduler::isCancelled(); ms++)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+		else if (command.compare("REGION") == 0)
+		{
+			// (number of records, sum of records)
+			EasyMPI::FileRegion region;
+			partialResult[0] = 0;
+			partialResult[1] = 0;
+			if (EasyMPI::MPIScheduler::mapFileRegion(task, region))
+			{
+				long long record = 0;
+				for (size_t i = 0; i < region.length; i++)
+				{
+					if (region.data[i] == '\n')
+					{
+						partialResult[0]++;
+						partialResult[1] += record;
+						record = 0;
+					}
+					else
+						record = 10 * record + (region.data[i] - '0');
+				}
+			}
+		}
+
+		EasyMPI::MPIScheduler::slaveFinishedTask(partialResult);
+	}
+}
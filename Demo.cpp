@@ -1,9 +1,8 @@
 #include "EasyMPI.h"
 #include <iostream>
 #include <string>
-#include <algorithm>
 
-void slaveDemo(std::vector<EasyMPI::Task> taskList);
+void slaveDemo();
 
 /*!
  * This demo has the master send two tasks SIMPLE_DEMO and PARAM_LIST_DEMO to slaves. 
@@ -30,18 +29,19 @@ int main(int argc, char* argv[])
 	taskList.push_back(EasyMPI::Task("SIMPLE_DEMO", "this is a parameter string"));
 	taskList.push_back(EasyMPI::Task("PARAM_LIST_DEMO", paramString));
 
+	// with only one process, the master runs the slave loop on threads
+	EasyMPI::MPIScheduler::setSlaveFunction(slaveDemo);
+
 	// begin master/slave demo
-	// this also handles the case when number of processes is 1
-	if (EasyMPI::MPIScheduler::getProcessID() == 0 && EasyMPI::MPIScheduler::getNumProcesses() > 1)
+	if (EasyMPI::MPIScheduler::getProcessID() == 0)
 	{
 		// run scheduler if master
 		EasyMPI::MPIScheduler::masterScheduleTasks(taskList);
 	}
 	else
 	{
-		// run if slave or number of processes is 1
-		std::reverse(taskList.begin(), taskList.end()); // if you want to preserve task ordering
-		slaveDemo(taskList);
+		// run if slave
+		slaveDemo();
 	}
 
 	// finalize: anything called after this cannot use MPI
@@ -52,32 +52,14 @@ int main(int argc, char* argv[])
 
 // The slave is responsible for checking (command, parameters) sent by the master.
 // Simply create logic to handle different command cases.
-// This also handles for when number of processes is 1.
-void slaveDemo(std::vector<EasyMPI::Task> taskList)
+// With one process, it runs on slave threads of the master.
+void slaveDemo()
 {
 	// loop to wait for tasks
 	while (true)
 	{
-		// wait for a task
-		EasyMPI::Task task;
-
-		// wait for task if more than one process
-		// otherwise if only one process, then perform task on master process
-		if (EasyMPI::MPIScheduler::getNumProcesses() > 1)
-		{
-			// block until a task is received from the master
-			task = EasyMPI::MPIScheduler::slaveWaitForTasks();
-		}
-		else
-		{
-			// if only one process is available, the master also processes tasks
-			if (taskList.empty())
-				break;
-
-			// note: gets task from the back
-			task = taskList.back();
-			taskList.pop_back();
-		}
+		// block until a task is received from the master
+		EasyMPI::Task task = EasyMPI::MPIScheduler::slaveWaitForTasks();
 
 		// print message received
 		std::cout << "Got command '" << task.getCommand() << "' and parameters '" << task.getParameters() << "' from master" << std::endl;
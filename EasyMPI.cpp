@@ -3,14 +3,39 @@
 #include <iomanip>
 #include <sstream>
 #include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cmath>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#ifdef __linux__
+#include <sched.h>
+#endif
+#endif
 
 namespace EasyMPI
 {
 	/*** EasyMPI ***/
 
-	const int MPIScheduler::MAX_MESSAGE_SIZE = 128; // be careful setting this manually; need to check Task class too
+	const int MPIScheduler::MAX_MESSAGE_SIZE = 128 + 24; // be careful setting this manually; need to check Task class too (24 for ";epoch;taskID" of two ints)
 	const int MPIScheduler::MAX_NUM_PROCESSES = 512;
 	const string MPIScheduler::MASTER_FINISH_COMMAND = "MASTERFINISHEDALLTASKS";
+	const string MPIScheduler::MASTER_BATCH_FINISH_COMMAND = "MASTERFINISHEDBATCH";
+	const string MPIScheduler::MASTER_PUBLISH_COMMAND = "MASTERPUBLISHDATA";
+	const string MPIScheduler::MASTER_CANCEL_COMMAND = "MASTERCANCELLEDTASK";
 	const string MPIScheduler::SLAVE_FINISH_COMMAND = "SLAVEFINISHEDTASK";
 	const string MPIScheduler::SYNCHRONIZATION_MASTER_MESSAGE = "MASTERSYNC";
 	const string MPIScheduler::SYNCHRONIZATION_SLAVE_MESSAGE = "SLAVESYNC";
@@ -21,12 +46,85 @@ namespace EasyMPI
 	bool MPIScheduler::finalized = false;
 	int MPIScheduler::syncCounter = 0;
 	MPI_Status* MPIScheduler::mpiStatus = NULL;
+	map<string, string> MPIScheduler::sharedData;
+	const string MPIScheduler::REDUCE_PARAMETER = "REDUCE";
+	const int MPIScheduler::RANGE_TAG = 1;
+	const string MPIScheduler::WORKER_TAGS_VARIABLE = "EASYMPI_WORKER_TAGS";
+	const string MPIScheduler::AFFINITY_VARIABLE = "EASYMPI_AFFINITY";
+	const double MPIScheduler::SPEED_SMOOTHING = 0.3;
+	bool MPIScheduler::reductionEnabled = false;
+	vector<double> MPIScheduler::reductionIdentity;
+	thread_local vector<double> MPIScheduler::reductionAccumulator;
+	vector<double> MPIScheduler::reducedResult;
+	size_t MPIScheduler::compressionThreshold = 64 * 1024;
+	vector<char> MPIScheduler::compressionBuffer;
+	MPIScheduler::CompressionStatistics MPIScheduler::compressionStatistics = MPIScheduler::CompressionStatistics();
+	vector<WorkerInfo> MPIScheduler::workers;
+	bool MPIScheduler::speedAware = false;
+	MPI_Comm MPIScheduler::masterComm = MPI_COMM_WORLD;
+	bool MPIScheduler::spawned = false;
+	vector<MPI_Comm> MPIScheduler::spawnedGroups;
+	const int MPIScheduler::SPAWN_TAG = 2;
+	const int MPIScheduler::WORKER_INFO_SIZE = 256;
+	vector<string> MPIScheduler::programArguments;
+	MPIScheduler::ElasticScaling MPIScheduler::elastic = MPIScheduler::ElasticScaling();
+	const string MPIScheduler::FILE_TABLE_NAME = "EASYMPIFILES";
+	vector<string> MPIScheduler::filePaths;
+	thread_local MappedFiles MPIScheduler::mappedFiles;
+	const string MPIScheduler::WRITE_PARAMETER = "WRITE";
+	string MPIScheduler::outputPath;
+	long long MPIScheduler::outputSize = 0;
+	thread_local vector<MPIScheduler::BufferedResult> MPIScheduler::bufferedResults;
+	thread_local vector<char> MPIScheduler::resultBuffer;
+	thread_local int MPIScheduler::currentTaskID = -1;
+	thread_local size_t MPIScheduler::currentResultLength = 0;
+	SlaveFunction MPIScheduler::slaveFunction = NULL;
+	int MPIScheduler::numSlaveThreads = 0;
+	int MPIScheduler::threadSupport = MPI_THREAD_SINGLE;
+	vector<MPIScheduler::ThreadWorker*> MPIScheduler::threadWorkers;
+	thread_local int MPIScheduler::threadWorkerID = 0;
+
+	/*!
+	 * A slave thread and the queues to and from the master.
+	 */
+	struct MPIScheduler::ThreadWorker
+	{
+		TaskRing toWorker; //!< Messages from the master
+		TaskRing toMaster; //!< Messages to the master
+		vector<double> accumulator; //!< Accumulator handed over at the end of a batch
+		vector<BufferedResult> bufferedResults; //!< Results handed over at the end of a batch
+		vector<char> resultBuffer; //!< Bytes of the handed over results
+		std::atomic<long long> cancelledTask; //!< taskKey() of the last task the master cancelled (-1 if none)
+		std::thread thread; //!< The thread
+
+		ThreadWorker() : cancelledTask(-1) {}
+	};
+
+	thread_local int MPIScheduler::currentEpoch = 0;
+	thread_local bool MPIScheduler::currentTaskCancelled = false;
+	const int MPIScheduler::CANCEL_TAG = 3;
+	ResultCache MPIScheduler::resultCache;
+	vector<int> MPIScheduler::affinityCPUs;
+	vector<int> MPIScheduler::cpuNodes;
+	thread_local int MPIScheduler::boundCPU = -1;
+	thread_local string MPIScheduler::currentTaskText;
+	thread_local vector<double> MPIScheduler::currentPartialResult;
+	MPI_Request MPIScheduler::slaveCancelRequest = MPI_REQUEST_NULL;
+	vector<char> MPIScheduler::slaveCancelBuffer;
+	MPI_Request MPIScheduler::slaveSendRequest = MPI_REQUEST_NULL;
+	MPI_Request MPIScheduler::slaveRecvRequest = MPI_REQUEST_NULL;
+	vector<char> MPIScheduler::slaveSendBuffer;
+	vector<char> MPIScheduler::slaveRecvBuffer;
+	CombineFunction MPIScheduler::reductionCombine = NULL;
+	MPI_Op MPIScheduler::reductionOp = MPI_OP_NULL;
+	MPI_Datatype MPIScheduler::reductionType = MPI_DATATYPE_NULL;
 
 	void MPIScheduler::initialize(int argc, char* argv[])
 	{
-		// initialize MPI
+		// initialize MPI; slave threads and parallelFor() threads run beside the main thread, 
+		// which makes all MPI calls
 		int rank, size;
-		int rc = MPI_Init(&argc, &argv);
+		int rc = MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &MPIScheduler::threadSupport);
 		if (rc != MPI_SUCCESS)
 		{
 			cerr << "Error starting MPI program. Terminating.";
@@ -43,10 +141,56 @@ namespace EasyMPI
 		MPIScheduler::mpiStatus = new MPI_Status();
 		MPIScheduler::initialized = true;
 		MPIScheduler::syncCounter = 0;
+		MPIScheduler::programArguments.assign(argv, argv + argc);
+
+		// spawned workers talk to the master through the parent intercommunicator
+		MPI_Comm parent;
+		MPI_Comm_get_parent(&parent);
+		if (parent != MPI_COMM_NULL)
+		{
+			MPIScheduler::masterComm = parent;
+			MPIScheduler::spawned = true;
+			joinParent();
+			return;
+		}
+
+		// bind by node-local rank (lower ranks with the same processor name) before anything is allocated
+		vector<char> processorNames(size * MPI_MAX_PROCESSOR_NAME, 0);
+		int nameLength;
+		MPI_Get_processor_name(&processorNames[rank * MPI_MAX_PROCESSOR_NAME], &nameLength);
+		MPI_Allgather(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, &processorNames[0], MPI_MAX_PROCESSOR_NAME, MPI_CHAR, MPI_COMM_WORLD);
+		int nodeRank = 0;
+		for (int i = 0; i < rank; i++)
+		{
+			if (strcmp(&processorNames[i * MPI_MAX_PROCESSOR_NAME], &processorNames[rank * MPI_MAX_PROCESSOR_NAME]) == 0)
+				nodeRank++;
+		}
+		setUpAffinity(nodeRank);
+
+		// slaves advertise their capabilities
+		gatherWorkerInfo();
 	}
 
 	void MPIScheduler::finalize()
 	{
+		slaveFreeRequests();
+		mappedFiles.unmapAll();
+
+		// the spawned groups have been sent the finish command by now
+		while (!MPIScheduler::spawnedGroups.empty())
+		{
+			disconnectGroup(MPIScheduler::spawnedGroups.back());
+		}
+		if (MPIScheduler::spawned)
+			MPI_Comm_disconnect(&MPIScheduler::masterComm);
+
+		if (MPIScheduler::reductionEnabled)
+		{
+			MPI_Op_free(&MPIScheduler::reductionOp);
+			MPI_Type_free(&MPIScheduler::reductionType);
+			MPIScheduler::reductionEnabled = false;
+		}
+
 		MPI_Finalize();
 		MPIScheduler::finalized = true;
 	}
@@ -69,7 +213,7 @@ namespace EasyMPI
 
 	int MPIScheduler::getProcessID()
 	{
-		return MPIScheduler::processID;
+		return MPIScheduler::threadWorkerID > 0 ? MPIScheduler::threadWorkerID : MPIScheduler::processID;
 	}
 
 	int MPIScheduler::getNumProcesses()
@@ -82,400 +226,3522 @@ namespace EasyMPI
 		return MPIScheduler::mpiStatus;
 	}
 
-	void MPIScheduler::masterScheduleTasks(vector<Task> taskList)
+	int MPIScheduler::getNumWorkers()
 	{
-		char recvbuff[MAX_MESSAGE_SIZE];
-		const int numTasks = taskList.size();
-		const int numProcesses = getNumProcesses();
-		const int rank = getProcessID();
+		return getWorkerIDs().size();
+	}
 
-		if (numProcesses == 1)
+	vector<int> MPIScheduler::getWorkerIDs()
+	{
+		vector<int> workerIDs;
+		for (size_t i = 1; i < workers.size(); i++)
+		{
+			if (workers[i].active)
+				workerIDs.push_back(i);
+		}
+
+		return workerIDs;
+	}
+
+	bool MPIScheduler::isSpawnedWorker()
+	{
+		return MPIScheduler::spawned;
+	}
+
+	void MPIScheduler::masterScheduleTasks(vector<Task> taskList)
+	{
+		if (getNumWorkers() == 0 && elastic.maxSpawnedWorkers <= 0 && slaveFunction == NULL)
 		{
 			cerr << "Cannot run master-slave with one process!" << endl;
 			return;
 		}
 
-		if (numTasks == 0)
+		// a single batch session; slaves only get the finish command at the end
+		MPISession session;
+		for (size_t i = 0; i < taskList.size(); i++)
 		{
-			cout << "No tasks. Nothing to process." << endl;
+			session.submit(taskList[i]);
 		}
-		else
+		session.runTasks();
+		session.close();
+	}
+
+	Task MPIScheduler::slaveWaitForTasks()
+	{
+		const int numProcesses = getNumProcesses();
+		const int rank = getProcessID();
+
+		Task task;
+
+		if (threadWorkerID > 0)
+			return threadWaitForTasks();
+
+		if (numProcesses == 1 && !spawned)
+			return task;
+
+		slaveInitRequests();
+
+		// wait until get a message from master
+		// will block until a message comes from the master!
+		while (true)
 		{
-			// state variables
-			vector<bool> finishedTasks; // maintain which tasks are completed
-			vector<int> processTask; // maintain which process is assigned to a task
-			queue<int> unassignedTasks; // maintain queue of tasks waiting to be processed
-			queue<int> availableProcesses; // maintain queue of available processes for work
+			// wait for message from master
+			MPI_Start(&slaveRecvRequest);
+			MPI_Wait(&slaveRecvRequest, MPIScheduler::mpiStatus);
+
+			// process full message into command and message components
+			string fullMessage(&slaveRecvBuffer[0], MAX_MESSAGE_SIZE);
+			task = Task::parseFullMessage(fullMessage);
 
-			// initialize state
-			for (int i = 0; i < numTasks; i++)
+			// published data is handled here; keep waiting for a task
+			if (task.getCommand().compare(MASTER_PUBLISH_COMMAND) == 0)
 			{
-				finishedTasks.push_back(false);
-				unassignedTasks.push(i);
+				slaveReceivePublishedData(task);
+				continue;
 			}
-			processTask.push_back(-1); // process 0
-			for (int i = 1; i < numProcesses; i++)
+
+			// reduce partial results and write results at the end of a batch
+			if (task.getCommand().compare(MASTER_BATCH_FINISH_COMMAND) == 0 || task.getCommand().compare(MASTER_FINISH_COMMAND) == 0)
 			{
-				availableProcesses.push(i);
-				processTask.push_back(-1);
+				vector<string> paramList = ParameterTools::parseParameterString(task.getParameters());
+				if (find(paramList.begin(), paramList.end(), REDUCE_PARAMETER) != paramList.end())
+				{
+					if (!reductionEnabled)
+					{
+						cerr << "Master asked for a reduction but setReduction() was not called on slave [" << rank << "/" << numProcesses << "]!" << endl;
+						abortMPI(1);
+					}
+					reduceAccumulators();
+				}
+				if (find(paramList.begin(), paramList.end(), WRITE_PARAMETER) != paramList.end())
+				{
+					slaveWriteOrderedOutput();
+				}
+				else
+				{
+					// no ordered output: the results of the batch are not needed any more
+					bufferedResults.clear();
+					resultBuffer.clear();
+				}
 			}
 
-			// assign as many tasks to processes as possible
-			while (!availableProcesses.empty())
+			// results written from here on belong to this task
+			currentTaskID = task.getTaskID();
+			currentEpoch = task.getEpoch();
+			currentResultLength = 0;
+			currentTaskCancelled = false;
+			if (resultCache.isEnabled())
+				currentTaskText = ResultCache::encode(task);
+
+			if (!task.isEmpty())
 			{
-				if (unassignedTasks.empty())
-					break;
+				cout << "Slave [" << rank << "/" << numProcesses << "]" << " got the command '" 
+					<< task.getCommand() << "' and parameters '" << task.getParameters() << "' from master (epoch " << task.getEpoch() << ")." << endl;
 
-				// get available process
-				int slaveID = availableProcesses.front();
-				availableProcesses.pop();
+				break;
+			}
+			else
+			{
+				cout << "Got empty task!" << endl;
+			}
+		}
 
-				// get task
-				int taskID = unassignedTasks.front();
-				unassignedTasks.pop();
+		return task;
+	}
 
-				// assign task to available process by sending message to slave
-				cout << "Master is assigning task to slave [" << slaveID << "/" << numProcesses << "]." << endl;
-				string fullMessage = Task::constructFullMessage(taskList[taskID]);
-				const char* fullMessageString = fullMessage.c_str();
-				int ierr = MPI_Send(const_cast<char*>(fullMessageString), MAX_MESSAGE_SIZE, MPI_CHAR, slaveID, 0, MPI_COMM_WORLD);
+	void MPIScheduler::slaveFinishedTask()
+	{
+		const int numProcesses = getNumProcesses();
+		const int rank = getProcessID();
 
-				// update state
-				processTask[slaveID] = taskID;
+		// memoize the result before the master hears of it, so it can index the entry
+		if (resultCache.isEnabled() && currentTaskID >= 0 && !currentTaskCancelled)
+		{
+			const char* result = NULL;
+			if (currentResultLength > 0)
+			{
+				const BufferedResult& bufferedResult = bufferedResults.back();
+				result = &resultBuffer[bufferedResult.position];
 			}
+			resultCache.store(currentTaskText, result, currentResultLength, currentPartialResult);
+		}
+		currentPartialResult.clear();
 
-			// wait for messages until all tasks are assigned and completed
-			while (true)
+		// the finished message carries the size of the written result, if any
+		Task finished(SLAVE_FINISH_COMMAND);
+		if (currentResultLength > 0)
+		{
+			stringstream lengthSS;
+			lengthSS << currentResultLength;
+			finished = Task(SLAVE_FINISH_COMMAND, lengthSS.str());
+		}
+
+		// slave threads queue it for the master
+		if (threadWorkerID > 0)
+		{
+			int numPolls = 0;
+			while (!threadWorkers[threadWorkerID]->toMaster.push(finished))
+				TaskRing::backoff(numPolls);
+			return;
+		}
+
+		if (numProcesses == 1 && !spawned)
+			return;
+
+		slaveInitRequests();
+
+		// send master the finished message; the previous one must be done before reusing the buffer
+		cout << "Slave [" << rank << "/" << numProcesses << "] is telling master it has finished a task." << endl;
+		string fullMessage = Task::constructFullMessage(finished);
+		MPI_Wait(&slaveSendRequest, MPI_STATUS_IGNORE);
+		memcpy(&slaveSendBuffer[0], fullMessage.c_str(), MAX_MESSAGE_SIZE);
+		MPI_Start(&slaveSendRequest);
+	}
+
+	Task MPIScheduler::threadWaitForTasks()
+	{
+		ThreadWorker& self = *threadWorkers[threadWorkerID];
+		Task task;
+
+		int numPolls = 0;
+		while (!self.toWorker.pop(task))
+			TaskRing::backoff(numPolls);
+
+		// hand the partial result and the written results over at the end of a batch
+		if (task.getCommand().compare(MASTER_BATCH_FINISH_COMMAND) == 0 || task.getCommand().compare(MASTER_FINISH_COMMAND) == 0)
+		{
+			vector<string> paramList = ParameterTools::parseParameterString(task.getParameters());
+			if (find(paramList.begin(), paramList.end(), REDUCE_PARAMETER) != paramList.end())
 			{
-				int msgFlag = 0;
-				MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &msgFlag, MPIScheduler::mpiStatus);
+				self.accumulator.swap(reductionAccumulator);
+				reductionAccumulator = reductionIdentity;
+			}
+			if (find(paramList.begin(), paramList.end(), WRITE_PARAMETER) != paramList.end())
+			{
+				self.bufferedResults.swap(bufferedResults);
+				self.resultBuffer.swap(resultBuffer);
+			}
+			else
+			{
+				bufferedResults.clear();
+				resultBuffer.clear();
+			}
 
-				// if a messsage is available
-				if (msgFlag)
-				{
-					// get the message tag and especially the source
-					int messageID = (*MPIScheduler::mpiStatus).MPI_TAG;
-					int messageSource = (*MPIScheduler::mpiStatus).MPI_SOURCE;
-					cout << "A message from process [" << messageSource << "/" << numProcesses << "]." << endl;
+			// the master waits until every slave thread handed its part over
+			if (!paramList.empty())
+			{
+				numPolls = 0;
+				while (!self.toMaster.push(Task(SLAVE_FINISH_COMMAND)))
+					TaskRing::backoff(numPolls);
+			}
+		}
 
-					// receive the message into the buffer and check if it is the correct (slave finish) command
-					int ierr = MPI_Recv(recvbuff, MAX_MESSAGE_SIZE, MPI_CHAR, messageSource, 0, MPI_COMM_WORLD, MPIScheduler::mpiStatus);
+		// results written from here on belong to this task
+		currentTaskID = task.getTaskID();
+		currentEpoch = task.getEpoch();
+		currentResultLength = 0;
+		currentTaskCancelled = false;
+		if (resultCache.isEnabled())
+			currentTaskText = ResultCache::encode(task);
 
-					// process full message into command and message components
-					string fullMessage = recvbuff;
-					Task task = Task::parseFullMessage(fullMessage);
-					string command = task.getCommand();
-					string message = task.getParameters();
+		cout << "Slave thread [" << threadWorkerID << "] got the command '" 
+			<< task.getCommand() << "' and parameters '" << task.getParameters() << "' from master (epoch " << task.getEpoch() << ")." << endl;
 
-					// check if correct (slave finish) message
-					const int commandSize = command.length();
-					bool correctMessage = true;
-					for (int i = 0; i < commandSize; i++)
-					{
-						if (command.at(i) != SLAVE_FINISH_COMMAND.at(i))
-						{
-							correctMessage = false;
-							break;
-						}
-					}
+		return task;
+	}
 
-					// if correct message, update state and check what else needs to be done
-					if (correctMessage)
-					{
-						cout << "Master received finished message from slave [" << messageSource << "/" << numProcesses << "]." << endl;
+	void MPIScheduler::slaveInitRequests()
+	{
+		if (slaveRecvRequest != MPI_REQUEST_NULL)
+			return;
 
-						// get completed task ID
-						int taskID = processTask[messageSource];
+		slaveSendBuffer.assign(MAX_MESSAGE_SIZE, 0);
+		slaveRecvBuffer.assign(MAX_MESSAGE_SIZE, 0);
+		MPI_Send_init(&slaveSendBuffer[0], MAX_MESSAGE_SIZE, MPI_CHAR, 0, 0, masterComm, &slaveSendRequest);
+		MPI_Recv_init(&slaveRecvBuffer[0], MAX_MESSAGE_SIZE, MPI_CHAR, 0, 0, masterComm, &slaveRecvRequest);
 
-						// sanity check
-						if (taskID < 0 || taskID >= numTasks)
-						{
-							cerr << "Task ID '" << taskID << "' gotten is invalid!" << endl;
-							abortMPI(1);
-						}
+		// cancellations can arrive at any time, so their receive is always posted
+		slaveCancelBuffer.assign(MAX_MESSAGE_SIZE, 0);
+		MPI_Recv_init(&slaveCancelBuffer[0], MAX_MESSAGE_SIZE, MPI_CHAR, 0, CANCEL_TAG, masterComm, &slaveCancelRequest);
+		MPI_Start(&slaveCancelRequest);
+	}
 
-						// update state
-						processTask[messageSource] = -1;
-						finishedTasks[taskID] = true;
-						availableProcesses.push(messageSource);
+	void MPIScheduler::slaveFreeRequests()
+	{
+		if (slaveRecvRequest == MPI_REQUEST_NULL)
+			return;
 
-						// check if any other tasks need to be processed
-						// otherwise check all tasks are completed
-						if (!unassignedTasks.empty())
-						{
-							// get available process
-							int slaveID = availableProcesses.front();
-							availableProcesses.pop();
-
-							// get task
-							int taskID = unassignedTasks.front();
-							unassignedTasks.pop();
-
-							// assign task to available process by sending message to slave
-							cout << "Master is assigning task to slave [" << slaveID << "/" << numProcesses << "]." << endl;
-							string fullMessage = Task::constructFullMessage(taskList[taskID]);
-							const char* fullMessageString = fullMessage.c_str();
-							int ierr = MPI_Send(const_cast<char*>(fullMessageString), MAX_MESSAGE_SIZE, MPI_CHAR, slaveID, 0, MPI_COMM_WORLD);
-
-							// update state
-							processTask[slaveID] = taskID;
-						}
-						else
-						{
-							// test if every task is finished
-							bool allFinish = true;
-							for (int i = 0; i < numTasks; i++)
-							{
-								if (!finishedTasks[i])
-								{
-									cout << "Task " << i << " is still being processed..." << endl;
-									allFinish = false;
-								}
-							}
-							if (allFinish)
-							{
-								break;
-							}
-						}
-					}
-				}
-			}
-			cout << "All tasks are finished!" << endl;
+		MPI_Wait(&slaveSendRequest, MPI_STATUS_IGNORE);
+		MPI_Request_free(&slaveSendRequest);
+		MPI_Request_free(&slaveRecvRequest);
+
+		MPI_Cancel(&slaveCancelRequest);
+		MPI_Wait(&slaveCancelRequest, MPI_STATUS_IGNORE);
+		MPI_Request_free(&slaveCancelRequest);
+	}
+
+	bool MPIScheduler::isCancelled()
+	{
+		if (currentTaskCancelled || currentTaskID < 0)
+			return currentTaskCancelled;
+
+		// slave threads get a flag from the master
+		if (threadWorkerID > 0)
+		{
+			currentTaskCancelled = threadWorkers[threadWorkerID]->cancelledTask.load(std::memory_order_acquire) == taskKey(currentEpoch, currentTaskID);
+			return currentTaskCancelled;
 		}
 
-		// everything finished, so send finish command to all slaves
-		for (int slaveID = 1; slaveID < getNumProcesses(); slaveID++)
+		if (getNumProcesses() == 1 && !spawned)
+			return false;
+
+		slaveInitRequests();
+
+		// go through the cancellations that arrived; those of earlier tasks are stale
+		int arrived = 0;
+		MPI_Test(&slaveCancelRequest, &arrived, MPI_STATUS_IGNORE);
+		while (arrived)
 		{
-			cout << "Master is telling slave [" << slaveID << "/" << numProcesses << "] that all tasks are done." << endl;
-			string fullMessage = Task::constructFullMessage(Task(MASTER_FINISH_COMMAND));
-			const char* fullMessageString = fullMessage.c_str();
-			int ierr = MPI_Send(const_cast<char*>(fullMessageString), MAX_MESSAGE_SIZE, MPI_CHAR, slaveID, 0, MPI_COMM_WORLD);
+			Task cancel = Task::parseFullMessage(string(&slaveCancelBuffer[0], MAX_MESSAGE_SIZE));
+			if (cancel.getEpoch() == currentEpoch && cancel.getTaskID() == currentTaskID)
+				currentTaskCancelled = true;
+
+			MPI_Start(&slaveCancelRequest);
+			MPI_Test(&slaveCancelRequest, &arrived, MPI_STATUS_IGNORE);
 		}
+
+		return currentTaskCancelled;
 	}
 
-	Task MPIScheduler::slaveWaitForTasks()
+	long long MPIScheduler::taskKey(int epoch, int taskID)
 	{
-		const int numProcesses = getNumProcesses();
-		const int rank = getProcessID();
+		return ((long long)epoch << 32) | (unsigned int)taskID;
+	}
 
-		Task task;
+	void MPIScheduler::slaveFinishedTask(const vector<double>& partialResult)
+	{
+		if (!reductionEnabled)
+		{
+			cerr << "Cannot fold a partial result without calling setReduction()!" << endl;
+			abortMPI(1);
+		}
 
-		if (numProcesses == 1)
-			return task;
+		if (partialResult.size() != reductionAccumulator.size())
+		{
+			cerr << "Partial result has " << partialResult.size() << " values but the accumulator has " << reductionAccumulator.size() << "!" << endl;
+			abortMPI(1);
+		}
 
-		char recvbuff[MAX_MESSAGE_SIZE];
+		// fold into the local accumulator, unless the task was cancelled
+		if (!partialResult.empty() && !isCancelled())
+			reductionCombine(&partialResult[0], &reductionAccumulator[0], reductionAccumulator.size());
+		if (resultCache.isEnabled())
+			currentPartialResult = partialResult;
 
-		// wait until get a message from master
-		// will block until a message comes from the master!
-		while (true)
+		slaveFinishedTask();
+	}
+
+	void MPIScheduler::setReduction(vector<double> identity, CombineFunction combine, bool commutative)
+	{
+		if (identity.empty() || combine == NULL)
 		{
-			// wait for message from master
-			int ierr = MPI_Recv(recvbuff, MAX_MESSAGE_SIZE, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPIScheduler::mpiStatus);
+			cerr << "A reduction needs a non-empty identity and a combine function!" << endl;
+			abortMPI(1);
+		}
 
-			// process full message into command and message components
-			string fullMessage = recvbuff;
-			task = Task::parseFullMessage(fullMessage);
+		// replace any previous reduction
+		if (reductionEnabled)
+		{
+			MPI_Op_free(&reductionOp);
+			MPI_Type_free(&reductionType);
+		}
 
-			if (!task.isEmpty())
-			{
-				cout << "Slave [" << rank << "/" << numProcesses << "]" << " got the command '" 
-					<< task.getCommand() << "' and parameters '" << task.getParameters() << "' from master." << endl;
+		// one element of this type is a whole accumulator, 
+		// so MPI never splits an accumulator when calling the operation
+		MPI_Type_contiguous(identity.size(), MPI_DOUBLE, &reductionType);
+		MPI_Type_commit(&reductionType);
+		MPI_Op_create(&MPIScheduler::reductionOpFunction, commutative ? 1 : 0, &reductionOp);
 
-				break;
+		reductionIdentity = identity;
+		reductionAccumulator = identity;
+		reducedResult = identity;
+		reductionCombine = combine;
+		reductionEnabled = true;
+	}
+
+	void MPIScheduler::setResultCache(string directory, long long maxBytes)
+	{
+		resultCache.open(directory, maxBytes);
+	}
+
+	vector<double> MPIScheduler::getReducedResult()
+	{
+		return reducedResult;
+	}
+
+	void MPIScheduler::reduceAccumulators()
+	{
+		const int length = reductionAccumulator.size();
+
+		// the master contributes the partial results of groups retired during the batch (or the identity)
+		vector<double> result(length);
+		if (getProcessID() != 0)
+		{
+			MPI_Reduce(&reductionAccumulator[0], &result[0], 1, reductionType, reductionOp, 0, masterComm);
+		}
+		else
+		{
+			MPI_Reduce(&reductionAccumulator[0], &result[0], 1, reductionType, reductionOp, 0, MPI_COMM_WORLD);
+			reductionAccumulator = result;
+			for (size_t i = 0; i < spawnedGroups.size(); i++)
+			{
+				reduceGroupAccumulators(spawnedGroups[i]);
 			}
-			else
+
+			// slave threads handed over their accumulators with the finish command
+			for (size_t i = 0; i < threadWorkers.size(); i++)
 			{
-				cout << "Got empty task!" << endl;
+				if (threadWorkers[i] == NULL)
+					continue;
+				vector<double>& threadAccumulator = threadWorkers[i]->accumulator;
+				reductionCombine(&reductionAccumulator[0], &threadAccumulator[0], length);
+				reductionAccumulator.swap(threadAccumulator);
 			}
+			reducedResult = reductionAccumulator;
 		}
 
-		return task;
+		// start the next batch from the identity
+		reductionAccumulator = reductionIdentity;
 	}
 
-	void MPIScheduler::slaveFinishedTask()
+	void MPIScheduler::reduceGroupAccumulators(MPI_Comm group)
+	{
+		// the spawned workers reduce to the master through the intercommunicator
+		vector<double> result(reductionAccumulator.size());
+		MPI_Reduce(NULL, &result[0], 1, reductionType, reductionOp, MPI_ROOT, group);
+
+		// groups come after the processes started by mpirun
+		reductionCombine(&reductionAccumulator[0], &result[0], result.size());
+		reductionAccumulator = result;
+	}
+
+	void MPIScheduler::reductionOpFunction(void* in, void* inout, int* len, MPI_Datatype*)
+	{
+		const int length = reductionIdentity.size();
+		const double* inValues = static_cast<const double*>(in);
+		double* inoutValues = static_cast<double*>(inout);
+
+		for (int i = 0; i < *len; i++)
+		{
+			reductionCombine(inValues + i*length, inoutValues + i*length, length);
+		}
+	}
+
+	void MPIScheduler::parallelFor(long long begin, long long end, long long grain, RangeFunction function)
 	{
+		if (isSpawnedWorker())
+		{
+			cerr << "Spawned worker [" << getProcessID() << "/" << getNumProcesses() << "] cannot take part in parallelFor()!" << endl;
+			return;
+		}
+
 		const int numProcesses = getNumProcesses();
-		const int rank = getProcessID();
+		const int numWorkers = numProcesses > 1 ? numProcesses - 1 : getNumSlaveThreads();
+
+		// automatic grain: several sub-ranges per worker for load balancing
+		if (grain <= 0)
+		{
+			const long long SUBRANGES_PER_WORKER = 8;
+			grain = (end - begin) / (numWorkers * SUBRANGES_PER_WORKER);
+			if (grain < 1)
+				grain = 1;
+		}
 
 		if (numProcesses == 1)
-			return;
+			threadProcessRange(begin, end, grain, function);
+		else if (getProcessID() == 0)
+			masterScheduleRange(begin, end, grain);
+		else
+			slaveProcessRanges(function);
+	}
 
-		// send master the finished message
-		cout << "Slave [" << rank << "/" << numProcesses << "] is telling master it has finished a task." << endl;
-		string fullMessage = Task::constructFullMessage(Task(SLAVE_FINISH_COMMAND));
-		const char* fullMessageString = fullMessage.c_str();
-		int ierr = MPI_Send(const_cast<char*>(fullMessageString), MAX_MESSAGE_SIZE, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+	void MPIScheduler::masterScheduleRange(long long begin, long long end, long long grain)
+	{
+		const int numProcesses = getNumProcesses();
+		long long next = begin;
+		int numBusySlaves = 0;
+		vector<double> sendTimes(numProcesses, 0); // to measure the speed of each slave
+		vector<long long> sendSizes(numProcesses, 0);
+
+		// range message: [begin, end); an empty range tells the slave to stop
+		long long range[2];
+
+		// every slave gets a sub-range, or is told to stop if there is none
+		for (int slaveID = 1; slaveID < numProcesses; slaveID++)
+		{
+			range[0] = next;
+			range[1] = std::min(next + rangeChunkSize(slaveID, grain), end);
+			if (range[0] < range[1])
+			{
+				next = range[1];
+				numBusySlaves++;
+			}
+			sendTimes[slaveID] = MPI_Wtime();
+			sendSizes[slaveID] = range[1] - range[0];
+			MPI_Send(range, 2, MPI_LONG_LONG, slaveID, RANGE_TAG, MPI_COMM_WORLD);
+		}
+
+		// hand out the rest as slaves finish
+		while (numBusySlaves > 0)
+		{
+			MPI_Recv(NULL, 0, MPI_LONG_LONG, MPI_ANY_SOURCE, RANGE_TAG, MPI_COMM_WORLD, mpiStatus);
+			int slaveID = (*mpiStatus).MPI_SOURCE;
+
+			double duration = MPI_Wtime() - sendTimes[slaveID];
+			if (duration > 0)
+				updateSpeed(workers[slaveID].rangeSpeed, sendSizes[slaveID] / duration);
+
+			range[0] = next;
+			range[1] = std::min(next + rangeChunkSize(slaveID, grain), end);
+			if (range[0] < range[1])
+				next = range[1];
+			else
+				numBusySlaves--;
+			sendTimes[slaveID] = MPI_Wtime();
+			sendSizes[slaveID] = range[1] - range[0];
+			MPI_Send(range, 2, MPI_LONG_LONG, slaveID, RANGE_TAG, MPI_COMM_WORLD);
+		}
+	}
+
+	long long MPIScheduler::rangeChunkSize(int slaveID, long long grain)
+	{
+		if (!speedAware || workers[slaveID].rangeSpeed <= 0)
+			return grain;
+
+		// mean speed of the slaves measured so far
+		double totalSpeed = 0;
+		int numMeasured = 0;
+		for (size_t i = 1; i < workers.size(); i++)
+		{
+			if (workers[i].rangeSpeed > 0)
+			{
+				totalSpeed += workers[i].rangeSpeed;
+				numMeasured++;
+			}
+		}
+
+		long long chunkSize = (long long)(grain * workers[slaveID].rangeSpeed / (totalSpeed / numMeasured) + 0.5);
+		return chunkSize < 1 ? 1 : chunkSize;
+	}
+
+	void MPIScheduler::slaveProcessRanges(RangeFunction function)
+	{
+		long long range[2];
+
+		while (true)
+		{
+			MPI_Recv(range, 2, MPI_LONG_LONG, 0, RANGE_TAG, MPI_COMM_WORLD, mpiStatus);
+			if (range[0] >= range[1])
+				break;
+
+			function(range[0], range[1]);
+
+			MPI_Send(NULL, 0, MPI_LONG_LONG, 0, RANGE_TAG, MPI_COMM_WORLD);
+		}
+	}
+
+	void MPIScheduler::threadProcessRange(long long begin, long long end, long long grain, RangeFunction function)
+	{
+		const int numThreads = getNumSlaveThreads();
+		std::atomic<long long> next(begin);
+
+		// each thread grabs the next sub-range until the range is done
+		struct Worker
+		{
+			static void run(int slot, std::atomic<long long>* next, long long end, long long grain, RangeFunction function)
+			{
+				if (slot > 0)
+					bindToSlot(slot);
+
+				while (true)
+				{
+					long long first = next->fetch_add(grain);
+					if (first >= end)
+						break;
+					function(first, std::min(first + grain, end));
+				}
+			}
+		};
+
+		// without thread support the calling thread does it all
+		vector<std::thread> threads;
+		for (int i = 1; i < numThreads && threadSupport >= MPI_THREAD_FUNNELED; i++)
+		{
+			threads.push_back(std::thread(&Worker::run, i, &next, end, grain, function));
+		}
+		Worker::run(0, &next, end, grain, function); // this thread works too
+		for (size_t i = 0; i < threads.size(); i++)
+		{
+			threads[i].join();
+		}
+	}
+
+	void MPIScheduler::synchronize()
+	{
+		stringstream ssMasterMessage;
+		ssMasterMessage << MPIScheduler::SYNCHRONIZATION_MASTER_MESSAGE << MPIScheduler::syncCounter;
+
+		stringstream ssSlaveMessage;
+		ssSlaveMessage << MPIScheduler::SYNCHRONIZATION_SLAVE_MESSAGE << MPIScheduler::syncCounter;
+
+		synchronize(ssMasterMessage.str(), ssSlaveMessage.str());
+
+		MPIScheduler::syncCounter++;
+	}
+
+	void MPIScheduler::masterPublishData(string name, const string& data)
+	{
+		if (getProcessID() != 0)
+		{
+			cerr << "Only the master process can publish data!" << endl;
+			return;
+		}
+
+		if (name.empty() || name.find(ParameterTools::PARAMETER_DELIMITER) != std::string::npos)
+		{
+			cerr << "Invalid name for published data: '" << name << "'" << endl;
+			abortMPI(1);
+		}
+
+		// find the range of bytes that changed since the last publish
+		size_t offset = 0;
+		size_t length = data.length();
+		map<string, string>::iterator it = sharedData.find(name);
+		if (it != sharedData.end() && it->second.length() == data.length())
+		{
+			const string& previous = it->second;
+			size_t first = 0;
+			while (first < length && previous[first] == data[first])
+				first++;
+
+			if (first == length)
+			{
+				cout << "Shared data '" << name << "' did not change. Nothing to publish." << endl;
+				return;
+			}
+
+			size_t last = length;
+			while (last > first && previous[last-1] == data[last-1])
+				last--;
+
+			offset = first;
+			length = last - first;
+		}
+
+		// store the master's copy
+		sharedData[name] = data;
+
+		sendPublishedData(name, offset, length, getWorkerIDs());
+	}
+
+	void MPIScheduler::sendPublishedData(string name, size_t offset, size_t length, const vector<int>& workerIDs)
+	{
+		if (workerIDs.empty())
+			return;
+
+		// compress large payloads if it pays off
+		string& stored = sharedData[name];
+		bool compressed = false;
+		size_t encodedLength = length;
+		if (compressionThreshold > 0 && length >= compressionThreshold)
+		{
+			double startTime = MPI_Wtime();
+			CompressionTools::compress(&stored[offset], length, compressionBuffer);
+			compressionStatistics.compressionSeconds += MPI_Wtime() - startTime;
+
+			if (compressionBuffer.size() < length)
+			{
+				compressed = true;
+				encodedLength = compressionBuffer.size();
+				compressionStatistics.numMessages++;
+				compressionStatistics.rawBytes += length;
+				compressionStatistics.encodedBytes += encodedLength;
+			}
+		}
+
+		// tell the slaves what is coming
+		stringstream offsetSS, lengthSS, totalSS, encodedLengthSS;
+		offsetSS << offset;
+		lengthSS << length;
+		totalSS << stored.length();
+		encodedLengthSS << encodedLength;
+		vector<string> paramList;
+		paramList.push_back(name);
+		paramList.push_back(offsetSS.str());
+		paramList.push_back(lengthSS.str());
+		paramList.push_back(totalSS.str());
+		paramList.push_back(compressed ? "1" : "0");
+		paramList.push_back(encodedLengthSS.str());
+		string fullMessage = Task::constructFullMessage(Task(MASTER_PUBLISH_COMMAND, ParameterTools::constructParameterString(paramList)));
+		const char* fullMessageString = fullMessage.c_str();
+		bool toWorld = false;
+		vector<MPI_Comm> groups;
+		for (size_t i = 0; i < workerIDs.size(); i++)
+		{
+			// slave threads share the master's copy
+			const WorkerInfo& worker = workers[workerIDs[i]];
+			if (worker.comm == MPI_COMM_NULL)
+				continue;
+			MPI_Send(const_cast<char*>(fullMessageString), MAX_MESSAGE_SIZE, MPI_CHAR, worker.rank, 0, worker.comm);
+
+			if (worker.comm == MPI_COMM_WORLD)
+				toWorld = true;
+			else if (find(groups.begin(), groups.end(), worker.comm) == groups.end())
+				groups.push_back(worker.comm);
+		}
+
+		// broadcast the changed bytes, on MPI_COMM_WORLD and to every spawned group
+		cout << "Master is publishing " << length << " of " << stored.length() << " bytes of shared data '" << name << "'" 
+			<< (compressed ? " compressed to " : " as ") << encodedLength << " bytes." << endl;
+		char* payload = compressed ? &compressionBuffer[0] : &stored[offset];
+		if (!compressed && length == 0)
+			return;
+		if (toWorld)
+			broadcastBuffer(payload, encodedLength, MPI_COMM_WORLD, 0);
+		for (size_t i = 0; i < groups.size(); i++)
+		{
+			broadcastBuffer(payload, encodedLength, groups[i], MPI_ROOT);
+		}
+	}
+
+	bool MPIScheduler::hasSharedData(string name)
+	{
+		return sharedData.find(name) != sharedData.end();
+	}
+
+	const string& MPIScheduler::getSharedData(string name)
+	{
+		static const string empty;
+
+		map<string, string>::const_iterator it = sharedData.find(name);
+		if (it == sharedData.end())
+		{
+			cerr << "No shared data was published as '" << name << "'!" << endl;
+			return empty;
+		}
+
+		return it->second;
+	}
+
+	void MPIScheduler::slaveReceivePublishedData(Task task)
+	{
+		vector<string> paramList = ParameterTools::parseParameterString(task.getParameters());
+		if (paramList.size() != 6)
+		{
+			cerr << "Invalid publish command: '" << task.getParameters() << "'" << endl;
+			abortMPI(1);
+		}
+
+		string name = paramList[0];
+		size_t offset = strtoull(paramList[1].c_str(), NULL, 10);
+		size_t length = strtoull(paramList[2].c_str(), NULL, 10);
+		size_t total = strtoull(paramList[3].c_str(), NULL, 10);
+		bool compressed = paramList[4].compare("1") == 0;
+		size_t encodedLength = strtoull(paramList[5].c_str(), NULL, 10);
+
+		string& stored = sharedData[name];
+		stored.resize(total);
+		if (compressed)
+		{
+			// receive into the reusable buffer and decompress into the local copy
+			compressionBuffer.resize(encodedLength);
+			broadcastBuffer(&compressionBuffer[0], encodedLength, masterComm, 0);
+
+			double startTime = MPI_Wtime();
+			if (!CompressionTools::decompress(&compressionBuffer[0], encodedLength, &stored[offset], length))
+			{
+				cerr << "Could not decompress shared data '" << name << "'!" << endl;
+				abortMPI(1);
+			}
+			compressionStatistics.decompressionSeconds += MPI_Wtime() - startTime;
+			compressionStatistics.numMessages++;
+			compressionStatistics.rawBytes += length;
+			compressionStatistics.encodedBytes += encodedLength;
+		}
+		else if (length > 0)
+		{
+			// receive directly into the local copy
+			broadcastBuffer(&stored[offset], length, masterComm, 0);
+		}
+
+		cout << "Slave [" << getProcessID() << "/" << getNumProcesses() << "] received " << length << " bytes of shared data '" << name << "'." << endl;
+	}
+
+	WorkerInfo MPIScheduler::getWorkerInfo(int processID)
+	{
+		if (processID < 0 || processID >= (int)workers.size())
+		{
+			cerr << "No worker information for process " << processID << "!" << endl;
+			return WorkerInfo();
+		}
+
+		return workers[processID];
+	}
+
+	void MPIScheduler::setSpeedAwareScheduling(bool enabled)
+	{
+		speedAware = enabled;
+	}
+
+	void MPIScheduler::gatherWorkerInfo()
+	{
+		const int numProcesses = getNumProcesses();
+
+		string info = describeWorker();
+		vector<char> sendBuffer(WORKER_INFO_SIZE, 0);
+		memcpy(&sendBuffer[0], info.c_str(), info.length());
+		vector<char> recvBuffer(getProcessID() == 0 ? numProcesses * WORKER_INFO_SIZE : 1);
+		MPI_Gather(&sendBuffer[0], WORKER_INFO_SIZE, MPI_CHAR, &recvBuffer[0], WORKER_INFO_SIZE, MPI_CHAR, 0, MPI_COMM_WORLD);
+
+		if (getProcessID() != 0)
+			return;
+
+		workers.assign(numProcesses, WorkerInfo());
+		for (int i = 0; i < numProcesses; i++)
+		{
+			parseWorkerInfo(string(&recvBuffer[i * WORKER_INFO_SIZE]), workers[i]);
+			workers[i].comm = MPI_COMM_WORLD;
+			workers[i].rank = i;
+			workers[i].active = true;
+		}
+	}
+
+	string MPIScheduler::describeWorker()
+	{
+		// cores
+		int cores = std::thread::hardware_concurrency();
+
+		// memory
+		long long memoryMB = 0;
+#ifdef _WIN32
+		MEMORYSTATUSEX memoryStatus;
+		memoryStatus.dwLength = sizeof(memoryStatus);
+		if (GlobalMemoryStatusEx(&memoryStatus))
+			memoryMB = memoryStatus.ullTotalPhys / (1024 * 1024);
+#else
+		long pages = sysconf(_SC_PHYS_PAGES);
+		long pageSize = sysconf(_SC_PAGE_SIZE);
+		if (pages > 0 && pageSize > 0)
+			memoryMB = (long long)pages * pageSize / (1024 * 1024);
+#endif
+
+		// tags
+		const char* tags = getenv(WORKER_TAGS_VARIABLE.c_str());
+
+		// cores,memory,binding,tag1,tag2,...
+		stringstream ss;
+		ss << cores << ParameterTools::PARAMETER_DELIMITER << memoryMB << ParameterTools::PARAMETER_DELIMITER << describeBinding(boundCPU);
+		if (tags != NULL && tags[0] != '\0')
+			ss << ParameterTools::PARAMETER_DELIMITER << tags;
+		string info = ss.str();
+		if ((int)info.length() >= WORKER_INFO_SIZE)
+		{
+			cerr << "Worker tags are too long: " << tags << endl;
+			info.resize(WORKER_INFO_SIZE - 1);
+		}
+
+		return info;
+	}
+
+	void MPIScheduler::parseWorkerInfo(string info, WorkerInfo& worker)
+	{
+		vector<string> fields = ParameterTools::parseParameterString(info);
+		if (fields.size() < 3)
+			return;
+
+		worker.cores = atoi(fields[0].c_str());
+		worker.memoryMB = atoll(fields[1].c_str());
+		worker.binding = fields[2];
+		worker.tags.assign(fields.begin() + 3, fields.end());
+	}
+
+	void MPIScheduler::joinParent()
+	{
+		// worker ID and number of processes started by mpirun
+		int header[2];
+		MPI_Recv(header, 2, MPI_INT, 0, SPAWN_TAG, masterComm, mpiStatus);
+		MPIScheduler::processID = header[0];
+		MPIScheduler::numProcesses = header[1];
+		setUpAffinity(MPIScheduler::processID);
+
+		string info = describeWorker();
+		vector<char> sendBuffer(WORKER_INFO_SIZE, 0);
+		memcpy(&sendBuffer[0], info.c_str(), info.length());
+		MPI_Send(&sendBuffer[0], WORKER_INFO_SIZE, MPI_CHAR, 0, SPAWN_TAG, masterComm);
+	}
+
+	void MPIScheduler::setUpAffinity(int slot)
+	{
+		const char* policy = getenv(AFFINITY_VARIABLE.c_str());
+		if (policy == NULL || policy[0] == '\0' || string(policy).compare("none") == 0)
+			return;
+
+		// NUMA node of every CPU (all on node 0 if the topology is unknown)
+		const int numCPUs = std::thread::hardware_concurrency();
+		cpuNodes.assign(numCPUs, 0);
+#ifdef _WIN32
+		for (int cpu = 0; cpu < numCPUs && cpu < 256; cpu++)
+		{
+			UCHAR node;
+			if (GetNumaProcessorNode((UCHAR)cpu, &node) && node != 0xFF)
+				cpuNodes[cpu] = node;
+		}
+#else
+		DIR* nodeDir = opendir("/sys/devices/system/node");
+		if (nodeDir != NULL)
+		{
+			struct dirent* dirEntry;
+			while ((dirEntry = readdir(nodeDir)) != NULL)
+			{
+				string name = dirEntry->d_name;
+				if (name.compare(0, 4, "node") != 0 || name.length() == 4 || !isdigit(name[4]))
+					continue;
+
+				// ranges like 0-3,8-11
+				std::ifstream in(("/sys/devices/system/node/" + name + "/cpulist").c_str());
+				string range;
+				while (getline(in, range, ','))
+				{
+					int first = atoi(range.c_str());
+					size_t dash = range.find('-');
+					int last = dash == string::npos ? first : atoi(range.c_str() + dash + 1);
+					for (int cpu = first; cpu <= last && cpu < numCPUs; cpu++)
+						cpuNodes[cpu] = atoi(name.c_str() + 4);
+				}
+			}
+			closedir(nodeDir);
+		}
+#endif
+
+		// compact fills one node after the other, scatter alternates between the nodes
+		affinityCPUs.clear();
+		string policyName = policy;
+		if (policyName.compare("compact") == 0 || policyName.compare("scatter") == 0)
+		{
+			vector< pair<int, int> > order;
+			vector<int> numOnNode(numCPUs, 0);
+			for (int cpu = 0; cpu < numCPUs; cpu++)
+			{
+				if (policyName.compare("compact") == 0)
+					order.push_back(make_pair(cpuNodes[cpu], cpu));
+				else
+					order.push_back(make_pair(numOnNode[cpuNodes[cpu]]++, cpu));
+			}
+			sort(order.begin(), order.end());
+			for (size_t i = 0; i < order.size(); i++)
+				affinityCPUs.push_back(order[i].second);
+		}
+		else
+		{
+			vector<string> ranges = ParameterTools::parseParameterString(policyName);
+			for (size_t i = 0; i < ranges.size(); i++)
+			{
+				int first = atoi(ranges[i].c_str());
+				size_t dash = ranges[i].find('-');
+				int last = dash == string::npos ? first : atoi(ranges[i].c_str() + dash + 1);
+				for (int cpu = first; cpu <= last; cpu++)
+				{
+					if (!isdigit(ranges[i][0]) || cpu >= numCPUs)
+					{
+						cerr << "Invalid CPU list in " << AFFINITY_VARIABLE << ": '" << policyName << "'!" << endl;
+						affinityCPUs.clear();
+						return;
+					}
+					affinityCPUs.push_back(cpu);
+				}
+			}
+		}
+
+		bindToSlot(slot);
+	}
+
+	int MPIScheduler::getSlotCPU(int slot)
+	{
+		if (affinityCPUs.empty())
+			return -1;
+		if (slot < (int)affinityCPUs.size())
+			return affinityCPUs[slot];
+		if (affinityCPUs.size() == 1)
+			return affinityCPUs[0];
+
+		// the first CPU belongs to the master
+		return affinityCPUs[1 + (slot - 1) % (affinityCPUs.size() - 1)];
+	}
+
+	void MPIScheduler::bindToSlot(int slot)
+	{
+		const int cpu = getSlotCPU(slot);
+		if (cpu < 0)
+			return;
+
+		bool bound = false;
+#ifdef _WIN32
+		bound = cpu < (int)(8 * sizeof(DWORD_PTR)) && SetThreadAffinityMask(GetCurrentThread(), (DWORD_PTR)1 << cpu) != 0;
+#elif defined(__linux__)
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(cpu, &cpuSet);
+		bound = sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+#endif
+		if (!bound)
+		{
+			cerr << "Process [" << getProcessID() << "/" << getNumProcesses() << "] could not be bound to CPU " << cpu << "!" << endl;
+			return;
+		}
+		boundCPU = cpu;
+	}
+
+	string MPIScheduler::describeBinding(int cpu)
+	{
+		if (cpu < 0)
+			return "none";
+
+		stringstream ss;
+		ss << "cpu " << cpu << " node " << (cpu < (int)cpuNodes.size() ? cpuNodes[cpu] : 0);
+		return ss.str();
+	}
+
+	void MPIScheduler::setElasticScaling(int maxSpawnedWorkers, int workersPerSpawn, double growBacklogPerWorker, double growDrainSeconds, double retireIdleSeconds, string command)
+	{
+		if (getProcessID() != 0)
+		{
+			cerr << "Only the master process can set up elastic scaling!" << endl;
+			return;
+		}
+
+		elastic.maxSpawnedWorkers = maxSpawnedWorkers;
+		elastic.workersPerSpawn = workersPerSpawn < 1 ? 1 : workersPerSpawn;
+		elastic.growBacklogPerWorker = growBacklogPerWorker;
+		elastic.growDrainSeconds = growDrainSeconds;
+		elastic.retireIdleSeconds = retireIdleSeconds;
+		elastic.command = command;
+	}
+
+	vector<int> MPIScheduler::spawnWorkers(int count)
+	{
+		vector<int> workerIDs;
+
+		// same program and arguments unless another command was given
+		string command = elastic.command;
+		vector<char*> arguments;
+		if (command.empty() && !programArguments.empty())
+		{
+			command = programArguments[0];
+			for (size_t i = 1; i < programArguments.size(); i++)
+			{
+				arguments.push_back(const_cast<char*>(programArguments[i].c_str()));
+			}
+		}
+		arguments.push_back(NULL);
+
+		cout << "Master is spawning " << count << " workers running '" << command << "'..." << endl;
+		MPI_Comm group;
+		vector<int> errorCodes(count);
+		MPI_Comm_set_errhandler(MPI_COMM_SELF, MPI_ERRORS_RETURN);
+		int rc = MPI_Comm_spawn(const_cast<char*>(command.c_str()), &arguments[0], count, MPI_INFO_NULL, 0, MPI_COMM_SELF, &group, &errorCodes[0]);
+		MPI_Comm_set_errhandler(MPI_COMM_SELF, MPI_ERRORS_ARE_FATAL);
+		if (rc != MPI_SUCCESS)
+		{
+			cerr << "Could not spawn workers running '" << command << "'!" << endl;
+			return workerIDs;
+		}
+
+		int groupSize;
+		MPI_Comm_remote_size(group, &groupSize);
+		spawnedGroups.push_back(group);
+
+		// hand out worker IDs that are never reused and collect the capabilities
+		vector<char> recvBuffer(WORKER_INFO_SIZE);
+		for (int rank = 0; rank < groupSize; rank++)
+		{
+			WorkerInfo worker;
+			int header[2] = { (int)workers.size(), getNumProcesses() };
+			MPI_Send(header, 2, MPI_INT, rank, SPAWN_TAG, group);
+			MPI_Recv(&recvBuffer[0], WORKER_INFO_SIZE, MPI_CHAR, rank, SPAWN_TAG, group, mpiStatus);
+			parseWorkerInfo(string(&recvBuffer[0]), worker);
+			worker.comm = group;
+			worker.rank = rank;
+			worker.active = true;
+
+			workerIDs.push_back(workers.size());
+			workers.push_back(worker);
+		}
+
+		// the new workers get everything published so far
+		for (map<string, string>::iterator it = sharedData.begin(); it != sharedData.end(); ++it)
+		{
+			sendPublishedData(it->first, 0, it->second.length(), workerIDs);
+		}
+
+		return workerIDs;
+	}
+
+	void MPIScheduler::disconnectGroup(MPI_Comm group)
+	{
+		for (size_t i = 1; i < workers.size(); i++)
+		{
+			if (workers[i].active && workers[i].comm == group)
+			{
+				workers[i].active = false;
+				workers[i].comm = MPI_COMM_NULL;
+			}
+		}
+
+		spawnedGroups.erase(find(spawnedGroups.begin(), spawnedGroups.end(), group));
+		MPI_Comm_disconnect(&group);
+	}
+
+	void MPIScheduler::setSlaveFunction(SlaveFunction function, int numThreads)
+	{
+		slaveFunction = function;
+		numSlaveThreads = numThreads;
+	}
+
+	int MPIScheduler::getNumSlaveThreads()
+	{
+		// one per core, leaving the master its own core if it is bound
+		if (numSlaveThreads > 0)
+			return numSlaveThreads;
+		return max(1, (int)std::thread::hardware_concurrency() - (affinityCPUs.empty() ? 0 : 1));
+	}
+
+	void MPIScheduler::startThreadWorkers()
+	{
+		if (threadSupport < MPI_THREAD_FUNNELED)
+		{
+			cerr << "MPI does not support threads (MPI_THREAD_FUNNELED), so the slave function cannot run on threads!" << endl;
+			abortMPI(1);
+		}
+
+		const int numThreads = getNumSlaveThreads();
+
+		// the slots of the threads of an earlier session are reused
+		vector<int> workerIDs;
+		for (size_t i = 1; i < workers.size() && (int)workerIDs.size() < numThreads; i++)
+		{
+			if (workers[i].thread)
+				workerIDs.push_back(i);
+		}
+
+		// new slave threads share the memory and tags of the master
+		while ((int)workerIDs.size() < numThreads)
+		{
+			WorkerInfo worker = workers[0];
+			worker.cores = 1;
+			worker.taskSpeed = 0;
+			worker.rangeSpeed = 0;
+			worker.numTasks = 0;
+			worker.comm = MPI_COMM_NULL;
+			worker.rank = workerIDs.size();
+			worker.thread = true;
+			worker.binding = describeBinding(getSlotCPU(worker.rank + 1));
+			workerIDs.push_back(workers.size());
+			workers.push_back(worker);
+		}
+		for (size_t i = 0; i < workerIDs.size(); i++)
+		{
+			workers[workerIDs[i]].active = true;
+		}
+
+		// every queue exists before the first thread looks it up
+		threadWorkers.resize(workers.size(), NULL);
+		for (size_t i = 0; i < workerIDs.size(); i++)
+		{
+			threadWorkers[workerIDs[i]] = new ThreadWorker();
+		}
+		for (size_t i = 0; i < workerIDs.size(); i++)
+		{
+			threadWorkers[workerIDs[i]]->thread = std::thread(runThreadWorker, workerIDs[i]);
+		}
+
+		cout << "Master started " << numThreads << " slave threads." << endl;
+	}
+
+	void MPIScheduler::stopThreadWorkers()
+	{
+		for (size_t i = 0; i < threadWorkers.size(); i++)
+		{
+			if (threadWorkers[i] == NULL)
+				continue;
+
+			threadWorkers[i]->thread.join();
+			delete threadWorkers[i];
+			workers[i].active = false;
+		}
+		threadWorkers.clear();
+	}
+
+	void MPIScheduler::runThreadWorker(int workerID)
+	{
+		// bound before the thread allocates its buffers
+		threadWorkerID = workerID;
+		bindToSlot(workers[workerID].rank + 1);
+		if (reductionEnabled)
+			reductionAccumulator = reductionIdentity;
+
+		slaveFunction();
+	}
+
+	void MPIScheduler::setOrderedOutput(string path)
+	{
+		if (getProcessID() != 0)
+		{
+			cerr << "Only the master process can set the ordered output!" << endl;
+			return;
+		}
+
+		outputPath = path;
+		outputSize = 0;
+	}
+
+	void MPIScheduler::slaveWriteResult(const string& result)
+	{
+		if (currentTaskID < 0)
+		{
+			cerr << "Results can only be written for tasks of a session or of masterScheduleTasks()!" << endl;
+			return;
+		}
+
+		// appending to the result of the same task extends it
+		if (!bufferedResults.empty() && bufferedResults.back().taskID == currentTaskID)
+		{
+			bufferedResults.back().length += result.length();
+		}
+		else
+		{
+			BufferedResult bufferedResult;
+			bufferedResult.taskID = currentTaskID;
+			bufferedResult.position = resultBuffer.size();
+			bufferedResult.length = result.length();
+			bufferedResults.push_back(bufferedResult);
+		}
+		resultBuffer.insert(resultBuffer.end(), result.begin(), result.end());
+		currentResultLength += result.length();
+	}
+
+	void MPIScheduler::writeOrderedOutput(const vector<long long>& resultSizes)
+	{
+		// results go in task order after the results of the previous batches
+		vector<long long> offsets(resultSizes.size());
+		for (size_t i = 0; i < resultSizes.size(); i++)
+		{
+			offsets[i] = outputSize;
+			outputSize += resultSizes[i];
+		}
+		cout << "Master is writing " << resultSizes.size() << " results to '" << outputPath << "' (" << outputSize << " bytes)." << endl;
+
+		// number of tasks, file size, path length
+		long long header[3] = { (long long)offsets.size(), outputSize, (long long)outputPath.length() };
+		vector< pair<MPI_Comm, int> > comms;
+		comms.push_back(make_pair(MPI_COMM_WORLD, 0));
+		for (size_t i = 0; i < spawnedGroups.size(); i++)
+		{
+			comms.push_back(make_pair(spawnedGroups[i], MPI_ROOT));
+		}
+		for (size_t i = 0; i < comms.size(); i++)
+		{
+			MPI_Bcast(header, 3, MPI_LONG_LONG, comms[i].second, comms[i].first);
+			MPI_Bcast(const_cast<char*>(outputPath.c_str()), outputPath.length(), MPI_CHAR, comms[i].second, comms[i].first);
+			if (!offsets.empty())
+				MPI_Bcast(&offsets[0], offsets.size(), MPI_LONG_LONG, comms[i].second, comms[i].first);
+		}
+
+		// the master has no results of its own (only those of its slave threads) but the open, resize and write are collective
+		writeResultBuffer(MPI_COMM_WORLD, outputPath, outputSize, offsets);
+	}
+
+	void MPIScheduler::slaveWriteOrderedOutput()
+	{
+		long long header[3];
+		MPI_Bcast(header, 3, MPI_LONG_LONG, 0, masterComm);
+		string path(header[2], '\0');
+		MPI_Bcast(&path[0], header[2], MPI_CHAR, 0, masterComm);
+		vector<long long> offsets(header[0]);
+		if (!offsets.empty())
+			MPI_Bcast(&offsets[0], offsets.size(), MPI_LONG_LONG, 0, masterComm);
+
+		// a spawned group writes on its own; the master resizes the file with the others
+		writeResultBuffer(MPI_COMM_WORLD, path, spawned ? -1 : header[1], offsets);
+	}
+
+	void MPIScheduler::writeResultBuffer(MPI_Comm comm, string path, long long fileSize, const vector<long long>& offsets)
+	{
+		// collective buffering: a few aggregators gather the pieces into large contiguous writes
+		MPI_Info info;
+		MPI_Info_create(&info);
+		MPI_Info_set(info, const_cast<char*>("romio_cb_write"), const_cast<char*>("enable"));
+		MPI_File file;
+		int rc = MPI_File_open(comm, const_cast<char*>(path.c_str()), MPI_MODE_CREATE | MPI_MODE_WRONLY, info, &file);
+		MPI_Info_free(&info);
+		if (rc != MPI_SUCCESS)
+		{
+			cerr << "Could not open output file '" << path << "'!" << endl;
+			abortMPI(1);
+		}
+		if (fileSize >= 0)
+			MPI_File_set_size(file, fileSize);
+
+		// the results of this process and of its slave threads
+		vector< vector<BufferedResult>* > resultSources(1, &bufferedResults);
+		vector< vector<char>* > bufferSources(1, &resultBuffer);
+		for (size_t i = 0; i < threadWorkers.size(); i++)
+		{
+			if (threadWorkers[i] != NULL)
+			{
+				resultSources.push_back(&threadWorkers[i]->bufferedResults);
+				bufferSources.push_back(&threadWorkers[i]->resultBuffer);
+			}
+		}
+
+		// in file order, addressed absolutely because they live in different buffers
+		vector< pair<long long, MPI_Aint> > order;
+		vector<int> lengthsByAddress;
+		for (size_t source = 0; source < resultSources.size(); source++)
+		{
+			const vector<BufferedResult>& results = *resultSources[source];
+			for (size_t i = 0; i < results.size(); i++)
+			{
+				const BufferedResult& result = results[i];
+				if (result.taskID < 0 || result.taskID >= (int)offsets.size())
+				{
+					cerr << "Master has no offset for the result of task " << result.taskID << "!" << endl;
+					abortMPI(1);
+				}
+				if (result.length == 0)
+					continue;
+				MPI_Aint address;
+				MPI_Get_address(&(*bufferSources[source])[result.position], &address);
+				order.push_back(make_pair(offsets[result.taskID], address));
+				lengthsByAddress.push_back(result.length);
+			}
+		}
+		vector<size_t> sorted(order.size());
+		for (size_t i = 0; i < sorted.size(); i++)
+			sorted[i] = i;
+		sort(sorted.begin(), sorted.end(), [&order](size_t a, size_t b) { return order[a].first < order[b].first; });
+
+		// one collective write: the file view selects the regions of this process 
+		// and the memory type picks the results out of the buffers without copying them
+		vector<int> lengths;
+		vector<MPI_Aint> fileDisplacements;
+		vector<MPI_Aint> memoryDisplacements;
+		for (size_t i = 0; i < sorted.size(); i++)
+		{
+			lengths.push_back(lengthsByAddress[sorted[i]]);
+			fileDisplacements.push_back(order[sorted[i]].first);
+			memoryDisplacements.push_back(order[sorted[i]].second);
+		}
+
+		if (lengths.empty())
+		{
+			MPI_File_set_view(file, 0, MPI_BYTE, MPI_BYTE, const_cast<char*>("native"), MPI_INFO_NULL);
+			MPI_File_write_all(file, NULL, 0, MPI_BYTE, MPI_STATUS_IGNORE);
+		}
+		else
+		{
+			MPI_Datatype fileType, memoryType;
+			MPI_Type_create_hindexed(lengths.size(), &lengths[0], &fileDisplacements[0], MPI_BYTE, &fileType);
+			MPI_Type_create_hindexed(lengths.size(), &lengths[0], &memoryDisplacements[0], MPI_BYTE, &memoryType);
+			MPI_Type_commit(&fileType);
+			MPI_Type_commit(&memoryType);
+
+			MPI_File_set_view(file, 0, MPI_BYTE, fileType, const_cast<char*>("native"), MPI_INFO_NULL);
+			MPI_File_write_all(file, MPI_BOTTOM, 1, memoryType, MPI_STATUS_IGNORE);
+
+			MPI_Type_free(&fileType);
+			MPI_Type_free(&memoryType);
+			cout << "Process [" << getProcessID() << "/" << getNumProcesses() << "] wrote " << lengths.size() << " results to '" << path << "'." << endl;
+		}
+
+		MPI_File_close(&file);
+		for (size_t source = 0; source < resultSources.size(); source++)
+		{
+			resultSources[source]->clear();
+			bufferSources[source]->clear();
+		}
+	}
+
+	int MPIScheduler::masterRegisterFile(string path)
+	{
+		if (getProcessID() != 0)
+		{
+			cerr << "Only the master process can register files!" << endl;
+			return -1;
+		}
+
+		vector<string>::iterator it = find(filePaths.begin(), filePaths.end(), path);
+		if (it != filePaths.end())
+			return it - filePaths.begin();
+
+		// one path per line
+		filePaths.push_back(path);
+		string table;
+		for (size_t i = 0; i < filePaths.size(); i++)
+		{
+			table += filePaths[i] + '\n';
+		}
+		masterPublishData(FILE_TABLE_NAME, table);
+
+		return filePaths.size() - 1;
+	}
+
+	vector<Task> MPIScheduler::masterSplitFile(string command, string path, size_t regionSize, char recordDelimiter)
+	{
+		vector<Task> taskList;
+
+		int fileID = masterRegisterFile(path);
+		if (fileID < 0)
+			return taskList;
+
+		size_t size;
+		const char* data = mappedFiles.mapFile(fileID, path, size);
+		if (data == NULL)
+			return taskList;
+
+		if (regionSize == 0)
+			regionSize = 1;
+
+		for (size_t begin = 0; begin < size; )
+		{
+			size_t end = size - begin > regionSize ? begin + regionSize : size;
+
+			// finish the record that crosses the boundary; only the pages around it are touched
+			if (end < size)
+			{
+				const char* delimiter = static_cast<const char*>(memchr(data + end - 1, recordDelimiter, size - end + 1));
+				end = delimiter == NULL ? size : delimiter - data + 1;
+			}
+
+			FileRegion region;
+			region.fileID = fileID;
+			region.offset = begin;
+			region.length = end - begin;
+			taskList.push_back(Task(command, region));
+
+			begin = end;
+		}
+
+		return taskList;
+	}
+
+	bool MPIScheduler::mapFileRegion(const Task& task, FileRegion& region)
+	{
+		region = task.getFileRegion();
+		if (region.fileID < 0)
+		{
+			cerr << "Task '" << task.getCommand() << "' is not a file region task!" << endl;
+			return false;
+		}
+
+		string path = getFilePath(region.fileID);
+		if (path.empty())
+		{
+			cerr << "No file was registered with ID " << region.fileID << "!" << endl;
+			return false;
+		}
+
+		size_t size;
+		const char* data = mappedFiles.mapFile(region.fileID, path, size);
+		if (data == NULL)
+			return false;
+
+		if (region.offset > size || region.length > size - region.offset)
+		{
+			cerr << "Region [" << region.offset << ", " << region.offset + region.length << ") is outside of file '" 
+				<< path << "' of " << size << " bytes!" << endl;
+			return false;
+		}
+
+		mappedFiles.advise(data, region.offset, region.length);
+		region.data = data + region.offset;
+
+		return true;
+	}
+
+	string MPIScheduler::getFilePath(int fileID)
+	{
+		// files registered since the last lookup
+		if (fileID >= (int)filePaths.size() && hasSharedData(FILE_TABLE_NAME))
+		{
+			stringstream ss(getSharedData(FILE_TABLE_NAME));
+			string path;
+			filePaths.clear();
+			while (getline(ss, path))
+			{
+				filePaths.push_back(path);
+			}
+		}
+		if (fileID < 0 || fileID >= (int)filePaths.size())
+			return "";
+
+		return filePaths[fileID];
+	}
+
+	void MPIScheduler::updateSpeed(double& speed, double sample)
+	{
+		if (speed <= 0)
+			speed = sample;
+		else
+			speed = SPEED_SMOOTHING * sample + (1 - SPEED_SMOOTHING) * speed;
+	}
+
+	void MPIScheduler::setCompressionThreshold(size_t threshold)
+	{
+		compressionThreshold = threshold;
+	}
+
+	void MPIScheduler::printStatistics(ostream& out)
+	{
+		const double MEGABYTE = 1024.0 * 1024.0;
+
+		out << "Statistics of process [" << getProcessID() << "/" << getNumProcesses() << "]:" << endl;
+		out << "\tBinding: " << describeBinding(boundCPU) << endl;
+
+		// workers
+		for (size_t i = 1; i < workers.size(); i++)
+		{
+			const WorkerInfo& worker = workers[i];
+			out << "\tWorker [" << i << "/" << getNumProcesses() << "]: " << worker.cores << " cores, " << worker.memoryMB << " MB, tags '" 
+				<< ParameterTools::constructParameterString(worker.tags) << "', bound to " << worker.binding << ", " << worker.numTasks << " tasks, speed " << worker.taskSpeed 
+				<< " cost/s, " << worker.rangeSpeed << " indices/s" << (worker.thread ? ", thread" : (worker.comm == MPI_COMM_WORLD ? "" : (worker.active ? ", spawned" : ", retired"))) << endl;
+		}
+
+		// compression
+		out << "\tCompressed messages: " << compressionStatistics.numMessages << endl;
+		if (compressionStatistics.numMessages > 0)
+		{
+			out << "\tCompressed " << compressionStatistics.rawBytes << " bytes to " << compressionStatistics.encodedBytes 
+				<< " bytes (ratio " << (double)compressionStatistics.rawBytes / compressionStatistics.encodedBytes << ")" << endl;
+			if (compressionStatistics.compressionSeconds > 0)
+				out << "\tCompression throughput: " << compressionStatistics.rawBytes / MEGABYTE / compressionStatistics.compressionSeconds << " MB/s" << endl;
+			if (compressionStatistics.decompressionSeconds > 0)
+				out << "\tDecompression throughput: " << compressionStatistics.rawBytes / MEGABYTE / compressionStatistics.decompressionSeconds << " MB/s" << endl;
+		}
+
+		// result cache
+		if (resultCache.isEnabled() && getProcessID() == 0)
+			resultCache.printStatistics(out);
+	}
+
+	void MPIScheduler::broadcastBuffer(char* buffer, size_t length, MPI_Comm comm, int root)
+	{
+		const size_t MAX_CHUNK_SIZE = 1 << 30;
+
+		for (size_t position = 0; position < length; position += MAX_CHUNK_SIZE)
+		{
+			size_t chunkSize = length - position < MAX_CHUNK_SIZE ? length - position : MAX_CHUNK_SIZE;
+			MPI_Bcast(buffer + position, (int)chunkSize, MPI_CHAR, root, comm);
+		}
+	}
+
+	void MPIScheduler::synchronize(string slaveBroadcastMsg, string masterBroadcastMsg)
+	{
+		if (isSpawnedWorker())
+		{
+			cerr << "Spawned worker [" << getProcessID() << "/" << getNumProcesses() << "] cannot synchronize with the processes started by mpirun!" << endl;
+			return;
+		}
+
+		masterWait(slaveBroadcastMsg);
+		slavesWait(masterBroadcastMsg);
+	}
+
+	void MPIScheduler::masterWait(string slaveBroadcastMsg)
+	{
+		// receive buffer
+		char recvbuff[MAX_MESSAGE_SIZE];
+		const char* SLAVEBROADCASTMSG = slaveBroadcastMsg.c_str();
+		const int SLAVEBROADCASTMSG_SIZE = slaveBroadcastMsg.length();
+
+		// master needs to wait here until all slaves reaches here
+		const int numProcesses = getNumProcesses();
+		const int rank = getProcessID();
+		if (rank == 0)
+		{
+			cout << "Master process [" << rank << "/" << numProcesses << "] is waiting to get " << slaveBroadcastMsg << " message from all slaves..." << endl;
+
+			// wait until all slaves are done
+			bool finish[MAX_NUM_PROCESSES];
+			finish[0] = true;
+			for (int i = 1; i < numProcesses; i++)
+			{
+				finish[i] = false;
+			}
+
+			// master process is now waiting for all slave processes to finish
+			while (true)
+			{
+				if (numProcesses <= 1)
+					break;
+
+				int msgFlag = 0;
+				MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &msgFlag, MPIScheduler::mpiStatus);
+
+				// if a messsage is available
+				if (msgFlag)
+				{
+					// get the message tag and especially source
+					int messageID = (*MPIScheduler::mpiStatus).MPI_TAG;
+					int messageSource = (*MPIScheduler::mpiStatus).MPI_SOURCE;
+					cout << "A message from process [" << messageSource << "/" << numProcesses << "]." << endl;
+
+					// receive the message into the buffer and check if it is the correct command
+					int ierr = MPI_Recv(recvbuff, SLAVEBROADCASTMSG_SIZE, MPI_CHAR, messageSource, 0, MPI_COMM_WORLD, MPIScheduler::mpiStatus);
+
+					// check if correct message
+					bool correctMessage = true;
+					for (int i = 0; i < SLAVEBROADCASTMSG_SIZE; i++)
+					{
+						if (recvbuff[i] != slaveBroadcastMsg[i])
+						{
+							correctMessage = false;
+							break;
+						}
+					}
+
+					if (correctMessage)
+					{
+						cout << "Received " << slaveBroadcastMsg << " message from process [" << messageSource << "/" << numProcesses << "]." << endl;
+						finish[messageSource] = true;
+
+						// test if every process is finished
+						bool allFinish = true;
+						for (int i = 1; i < numProcesses; i++)
+						{
+							if (!finish[i])
+							{
+								cout << "Process [" << i << "/" << numProcesses << "] is still not here yet..." << endl;
+								allFinish = false;
+							}
+						}
+						if (allFinish)
+						{
+							break;
+						}
+						cout << "Still waiting for all slaves to get here with the master..." << endl;
+					}
+				}
+			}
+
+			// MASTER CAN DO STUFF HERE BEFORE SLAVES PROCEED
+
+			cout << "Master process [" << rank << "/" << numProcesses << "] has continued..." << endl;
+		}
+		else
+		{
+			cout << "Slave process [" << rank << "/" << numProcesses << "] is sending arrival message " << SLAVEBROADCASTMSG << " to master..." << endl;
+
+			// send finish heuristic learning message to master
+			int ierr = MPI_Send(const_cast<char*>(SLAVEBROADCASTMSG), SLAVEBROADCASTMSG_SIZE, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+
+			cout << "Slave process [" << rank << "/" << numProcesses << "] has continued..." << endl;
+		}
+	}
+
+	void MPIScheduler::slavesWait(string masterBroadcastMsg)
+	{
+		// receive buffer
+		char recvbuff[MAX_MESSAGE_SIZE];
+		const char* MASTERBROADCASTMSG = masterBroadcastMsg.c_str();
+		const int MASTERBROADCASTMSG_SIZE = masterBroadcastMsg.length();
+
+		// slaves need to wait here until master reaches here
+		const int numProcesses = getNumProcesses();
+		const int rank = getProcessID();
+		if (rank == 0)
+		{
+			cout << "Master process [" << rank << "/" << numProcesses << "] is telling slave processes to continue..." << endl;
+
+			// tell each slave to continue
+			for (int j = 1; j < numProcesses; j++)
+			{
+				cout << "Master is sending slave process [" << j << "/" << numProcesses << "] the " << MASTERBROADCASTMSG << " message to continue..." << endl;
+				int ierr = MPI_Send(const_cast<char*>(MASTERBROADCASTMSG), MASTERBROADCASTMSG_SIZE, MPI_CHAR, j, 0, MPI_COMM_WORLD);
+			}
+
+			cout << "Master process [" << rank << "/" << numProcesses << "] is released..." << endl;
+		}
+		else
+		{
+			cout << "Slave process [" << rank << "/" << numProcesses << "] is waiting for master..." << endl;
+
+			// now wait until master gives the continue signal
+			while (true)
+			{
+				int ierr = MPI_Recv(recvbuff, MASTERBROADCASTMSG_SIZE, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPIScheduler::mpiStatus);
+
+				// check if correct message
+				bool correctMessage = true;
+				for (int i = 0; i < MASTERBROADCASTMSG_SIZE; i++)
+				{
+					if (recvbuff[i] != masterBroadcastMsg.at(i))
+					{
+						correctMessage = false;
+						break;
+					}
+				}
+
+				if (correctMessage)
+				{
+					cout << "Slave process [" << rank << "/" << numProcesses << "] got the " << masterBroadcastMsg << " message." << endl;
+					break;
+				}
+			}
+
+			cout << "Slave process [" << rank << "/" << numProcesses << "] is released..." << endl;
+		}
+	}
+
+
+
+	/*** MessageTransport ***/
+
+	const int MessageTransport::SLAB_SIZE = 64;
+	const int MessageTransport::TIMED_OUT = -2;
+
+	MessageTransport::MessageTransport()
+	{
+		this->numThreadRepliesExpected = 0;
+
+		vector<int> workerIDs = MPIScheduler::getWorkerIDs();
+		for (size_t i = 0; i < workerIDs.size(); i++)
+		{
+			addWorker(workerIDs[i]);
+		}
+	}
+
+	MessageTransport::~MessageTransport()
+	{
+		flush();
+		waitForSends();
+
+		for (size_t workerID = 0; workerID < this->sendRequests.size(); workerID++)
+		{
+			if (this->sendRequests[workerID] != MPI_REQUEST_NULL)
+				MPI_Request_free(&this->sendRequests[workerID]);
+			if (this->recvRequests[workerID] != MPI_REQUEST_NULL)
+				MPI_Request_free(&this->recvRequests[workerID]);
+		}
+	}
+
+	void MessageTransport::addWorker(int workerID)
+	{
+		const int messageSize = MPIScheduler::MAX_MESSAGE_SIZE;
+		const WorkerInfo& worker = MPIScheduler::workers[workerID];
+
+		if (workerID >= (int)this->sendRequests.size())
+		{
+			this->sendRequests.resize(workerID + 1, MPI_REQUEST_NULL);
+			this->recvRequests.resize(workerID + 1, MPI_REQUEST_NULL);
+			this->cancelRequests.resize(workerID + 1, MPI_REQUEST_NULL);
+			this->threadReplyExpected.resize(workerID + 1, false);
+		}
+
+		// slave threads need no buffers
+		if (worker.comm == MPI_COMM_NULL)
+			return;
+
+		// a new slab holds the send, receive and cancel buffers of the next SLAB_SIZE workers
+		while ((int)this->slabs.size() <= workerID / SLAB_SIZE)
+		{
+			this->slabs.push_back(vector<char>(3 * SLAB_SIZE * messageSize, 0));
+		}
+
+		MPI_Send_init(sendBuffer(workerID), messageSize, MPI_CHAR, worker.rank, 0, worker.comm, &this->sendRequests[workerID]);
+		MPI_Recv_init(recvBuffer(workerID), messageSize, MPI_CHAR, worker.rank, 0, worker.comm, &this->recvRequests[workerID]);
+	}
+
+	void MessageTransport::removeWorker(int workerID)
+	{
+		if (MPIScheduler::workers[workerID].comm == MPI_COMM_NULL)
+			return;
+
+		flush();
+		MPI_Wait(&this->cancelRequests[workerID], MPI_STATUS_IGNORE);
+		MPI_Wait(&this->sendRequests[workerID], MPI_STATUS_IGNORE);
+		MPI_Request_free(&this->sendRequests[workerID]);
+		MPI_Request_free(&this->recvRequests[workerID]);
+	}
+
+	char* MessageTransport::sendBuffer(int workerID)
+	{
+		const int messageSize = MPIScheduler::MAX_MESSAGE_SIZE;
+		return &this->slabs[workerID / SLAB_SIZE][(workerID % SLAB_SIZE) * messageSize];
+	}
+
+	char* MessageTransport::recvBuffer(int workerID)
+	{
+		const int messageSize = MPIScheduler::MAX_MESSAGE_SIZE;
+		return &this->slabs[workerID / SLAB_SIZE][(SLAB_SIZE + workerID % SLAB_SIZE) * messageSize];
+	}
+
+	char* MessageTransport::cancelBuffer(int workerID)
+	{
+		const int messageSize = MPIScheduler::MAX_MESSAGE_SIZE;
+		return &this->slabs[workerID / SLAB_SIZE][(2 * SLAB_SIZE + workerID % SLAB_SIZE) * messageSize];
+	}
+
+	void MessageTransport::send(int slaveID, Task task, bool expectReply)
+	{
+		const int messageSize = MPIScheduler::MAX_MESSAGE_SIZE;
+
+		// slave threads get the task through their queue right away
+		if (MPIScheduler::workers[slaveID].comm == MPI_COMM_NULL)
+		{
+			int numPolls = 0;
+			while (!MPIScheduler::threadWorkers[slaveID]->toWorker.push(task))
+				TaskRing::backoff(numPolls);
+			if (expectReply && !this->threadReplyExpected[slaveID])
+			{
+				this->threadReplyExpected[slaveID] = true;
+				this->numThreadRepliesExpected++;
+			}
+			return;
+		}
+
+		// the previous message to this slave must be out of the buffer
+		MPI_Wait(&this->sendRequests[slaveID], MPI_STATUS_IGNORE);
+
+		string fullMessage = Task::constructFullMessage(task);
+		memcpy(sendBuffer(slaveID), fullMessage.c_str(), messageSize);
+
+		// prepost the receive before the slave can reply
+		if (expectReply)
+			this->pendingRequests.push_back(this->recvRequests[slaveID]);
+		this->pendingRequests.push_back(this->sendRequests[slaveID]);
+	}
+
+	void MessageTransport::flush()
+	{
+		if (this->pendingRequests.empty())
+			return;
+
+		MPI_Startall(this->pendingRequests.size(), &this->pendingRequests[0]);
+		this->pendingRequests.clear();
+	}
+
+	void MessageTransport::sendCancel(int slaveID, Task task)
+	{
+		const int messageSize = MPIScheduler::MAX_MESSAGE_SIZE;
+
+		// slave threads poll a flag
+		if (MPIScheduler::workers[slaveID].comm == MPI_COMM_NULL)
+		{
+			MPIScheduler::threadWorkers[slaveID]->cancelledTask.store(MPIScheduler::taskKey(task.getEpoch(), task.getTaskID()), std::memory_order_release);
+			return;
+		}
+
+		// the previous cancellation to this slave must be out of the buffer
+		MPI_Wait(&this->cancelRequests[slaveID], MPI_STATUS_IGNORE);
+		char* buffer = cancelBuffer(slaveID);
+		string fullMessage = Task::constructFullMessage(task);
+		memcpy(buffer, fullMessage.c_str(), messageSize);
+
+		const WorkerInfo& worker = MPIScheduler::workers[slaveID];
+		MPI_Isend(buffer, messageSize, MPI_CHAR, worker.rank, MPIScheduler::CANCEL_TAG, worker.comm, &this->cancelRequests[slaveID]);
+	}
+
+	int MessageTransport::waitForReply(Task& task, double timeoutSeconds)
+	{
+		const int messageSize = MPIScheduler::MAX_MESSAGE_SIZE;
+		int index = MPI_UNDEFINED;
+
+		// poll the queues of the slave threads that owe a reply
+		int numPolls = 0;
+		while (this->numThreadRepliesExpected > 0)
+		{
+			for (size_t workerID = 0; workerID < this->threadReplyExpected.size(); workerID++)
+			{
+				if (this->threadReplyExpected[workerID] && MPIScheduler::threadWorkers[workerID]->toMaster.pop(task))
+				{
+					this->threadReplyExpected[workerID] = false;
+					this->numThreadRepliesExpected--;
+					return workerID;
+				}
+			}
+			TaskRing::backoff(numPolls);
+		}
+
+		// inactive and freed requests are ignored
+		if (this->recvRequests.empty())
+			return -1;
+		if (timeoutSeconds < 0)
+		{
+			MPI_Waitany(this->recvRequests.size(), &this->recvRequests[0], &index, MPIScheduler::getMPIStatus());
+		}
+		else
+		{
+			const double deadline = MPI_Wtime() + timeoutSeconds;
+			int flag = 0;
+			numPolls = 0;
+			while (true)
+			{
+				MPI_Testany(this->recvRequests.size(), &this->recvRequests[0], &index, &flag, MPIScheduler::getMPIStatus());
+				if (flag)
+					break;
+				if (MPI_Wtime() >= deadline)
+					return TIMED_OUT;
+				TaskRing::backoff(numPolls);
+			}
+		}
+		if (index == MPI_UNDEFINED)
+			return -1;
+
+		string fullMessage(recvBuffer(index), messageSize);
+		task = Task::parseFullMessage(fullMessage);
+
+		return index;
+	}
+
+	void MessageTransport::waitForSends()
+	{
+		if (!this->sendRequests.empty())
+			MPI_Waitall(this->sendRequests.size(), &this->sendRequests[0], MPI_STATUSES_IGNORE);
+		if (!this->cancelRequests.empty())
+			MPI_Waitall(this->cancelRequests.size(), &this->cancelRequests[0], MPI_STATUSES_IGNORE);
+	}
+
+
+
+	/*** MappedFiles ***/
+
+	const int MappedFiles::MAX_MAPPED_FILES = 64;
+
+	MappedFiles::MappedFiles()
+	{
+		this->useCounter = 0;
+	}
+
+	MappedFiles::~MappedFiles()
+	{
+		unmapAll();
+	}
+
+	const char* MappedFiles::mapFile(int fileID, string path, size_t& size)
+	{
+		static const char emptyFile[1] = { 0 };
+
+		map<int, MappedFile>::iterator it = this->files.find(fileID);
+		if (it != this->files.end())
+		{
+			it->second.lastUse = ++this->useCounter;
+			size = it->second.size;
+			return it->second.data;
+		}
+
+		// make room by unmapping the least recently used file
+		if ((int)this->files.size() >= MAX_MAPPED_FILES)
+		{
+			map<int, MappedFile>::iterator oldest = this->files.begin();
+			for (it = this->files.begin(); it != this->files.end(); ++it)
+			{
+				if (it->second.lastUse < oldest->second.lastUse)
+					oldest = it;
+			}
+			unmap(oldest->second);
+			this->files.erase(oldest);
+		}
+
+		MappedFile file;
+		file.data = emptyFile;
+		file.size = 0;
+		file.lastUse = ++this->useCounter;
+		file.fileHandle = NULL;
+		file.mappingHandle = NULL;
+
+#ifdef _WIN32
+		HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+		LARGE_INTEGER fileSize;
+		if (fileHandle == INVALID_HANDLE_VALUE || !GetFileSizeEx(fileHandle, &fileSize))
+		{
+			if (fileHandle != INVALID_HANDLE_VALUE)
+				CloseHandle(fileHandle);
+			cerr << "Could not open file '" << path << "'!" << endl;
+			return NULL;
+		}
+		file.size = fileSize.QuadPart;
+		file.fileHandle = fileHandle;
+
+		if (file.size > 0)
+		{
+			HANDLE mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+			const void* data = mappingHandle != NULL ? MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0) : NULL;
+			if (data == NULL)
+			{
+				if (mappingHandle != NULL)
+					CloseHandle(mappingHandle);
+				CloseHandle(fileHandle);
+				cerr << "Could not map file '" << path << "'!" << endl;
+				return NULL;
+			}
+			file.data = static_cast<const char*>(data);
+			file.mappingHandle = mappingHandle;
+		}
+#else
+		int fd = open(path.c_str(), O_RDONLY);
+		struct stat fileStat;
+		if (fd < 0 || fstat(fd, &fileStat) != 0)
+		{
+			if (fd >= 0)
+				close(fd);
+			cerr << "Could not open file '" << path << "'!" << endl;
+			return NULL;
+		}
+		file.size = fileStat.st_size;
+
+		if (file.size > 0)
+		{
+			void* data = mmap(NULL, file.size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				close(fd);
+				cerr << "Could not map file '" << path << "'!" << endl;
+				return NULL;
+			}
+			madvise(data, file.size, MADV_SEQUENTIAL);
+			file.data = static_cast<const char*>(data);
+		}
+
+		// the mapping stays valid without the descriptor
+		close(fd);
+#endif
+
+		this->files[fileID] = file;
+		size = file.size;
+		return file.data;
+	}
+
+	void MappedFiles::advise(const char* data, size_t offset, size_t length)
+	{
+#ifndef _WIN32
+		if (length == 0)
+			return;
+
+		// madvise needs a page-aligned start
+		size_t pageSize = sysconf(_SC_PAGE_SIZE);
+		size_t start = offset - offset % pageSize;
+		madvise(const_cast<char*>(data) + start, offset + length - start, MADV_WILLNEED);
+#endif
+	}
+
+	void MappedFiles::unmapAll()
+	{
+		for (map<int, MappedFile>::iterator it = this->files.begin(); it != this->files.end(); ++it)
+		{
+			unmap(it->second);
+		}
+		this->files.clear();
+	}
+
+	void MappedFiles::unmap(MappedFile& file)
+	{
+		if (file.size == 0)
+			return;
+
+#ifdef _WIN32
+		UnmapViewOfFile(file.data);
+		CloseHandle(file.mappingHandle);
+		CloseHandle(file.fileHandle);
+#else
+		munmap(const_cast<char*>(file.data), file.size);
+#endif
+	}
+
+
+
+	/*** ResultCache ***/
+
+	ResultCache::ResultCache()
+	{
+		this->maxBytes = 0;
+		this->totalBytes = 0;
+		this->useCounter = 0;
+		this->numHits = 0;
+		this->numMisses = 0;
+		this->numStored = 0;
+		this->numEvicted = 0;
+	}
+
+	void ResultCache::open(string directory, long long maxBytes)
+	{
+		this->directory = directory;
+		this->maxBytes = maxBytes;
+		this->entries.clear();
+		this->totalBytes = 0;
+		if (directory.empty())
+			return;
+
+#ifdef _WIN32
+		CreateDirectoryA(directory.c_str(), NULL);
+#else
+		mkdir(directory.c_str(), 0755);
+#endif
+
+		// only the master indexes the entries
+		if (MPIScheduler::getProcessID() != 0)
+			return;
+
+		// entries left by earlier runs, oldest first
+		vector< pair<long long, string> > found;
+#ifdef _WIN32
+		WIN32_FIND_DATAA findData;
+		HANDLE findHandle = FindFirstFileA((directory + "\\*.result").c_str(), &findData);
+		if (findHandle != INVALID_HANDLE_VALUE)
+		{
+			do
+			{
+				ULARGE_INTEGER writeTime;
+				writeTime.LowPart = findData.ftLastWriteTime.dwLowDateTime;
+				writeTime.HighPart = findData.ftLastWriteTime.dwHighDateTime;
+				found.push_back(make_pair((long long)writeTime.QuadPart, string(findData.cFileName)));
+
+				Entry entry;
+				entry.size = ((long long)findData.nFileSizeHigh << 32) | findData.nFileSizeLow;
+				entry.lastUse = 0;
+				this->entries[findData.cFileName] = entry;
+			} while (FindNextFileA(findHandle, &findData));
+			FindClose(findHandle);
+		}
+#else
+		DIR* dir = opendir(directory.c_str());
+		if (dir != NULL)
+		{
+			struct dirent* dirEntry;
+			while ((dirEntry = readdir(dir)) != NULL)
+			{
+				string name = dirEntry->d_name;
+				struct stat fileStat;
+				if (name.length() < 7 || name.compare(name.length() - 7, 7, ".result") != 0 
+					|| stat((directory + "/" + name).c_str(), &fileStat) != 0)
+					continue;
+
+				found.push_back(make_pair((long long)fileStat.st_mtime, name));
+
+				Entry entry;
+				entry.size = fileStat.st_size;
+				entry.lastUse = 0;
+				this->entries[name] = entry;
+			}
+			closedir(dir);
+		}
+#endif
+		sort(found.begin(), found.end());
+		for (size_t i = 0; i < found.size(); i++)
+		{
+			Entry& entry = this->entries[found[i].second];
+			entry.lastUse = ++this->useCounter;
+			this->totalBytes += entry.size;
+		}
+		evict();
+
+		cout << "Result cache '" << directory << "' has " << this->entries.size() << " entries (" << this->totalBytes << " bytes)." << endl;
+	}
+
+	bool ResultCache::isEnabled() const
+	{
+		return !this->directory.empty();
+	}
+
+	bool ResultCache::contains(const Task& task) const
+	{
+		const string taskText = encode(task);
+		return !taskText.empty() && this->entries.find(fileName(taskText)) != this->entries.end();
+	}
+
+	bool ResultCache::load(const Task& task, string& result, vector<double>& partialResult)
+	{
+		const string taskText = encode(task);
+		const string name = fileName(taskText);
+		if (taskText.empty())
+			return false;
+
+		map<string, Entry>::iterator it = this->entries.find(name);
+		if (it == this->entries.end())
+			return false;
+
+		// lengths of the task text, the result and the partial result
+		std::ifstream in((this->directory + "/" + name).c_str(), std::ios::binary);
+		unsigned long long header[3];
+		string storedText;
+		if (in.read((char*)header, sizeof(header)))
+		{
+			storedText.resize(header[0]);
+			result.resize(header[1]);
+			partialResult.resize(header[2]);
+			if (header[0] > 0)
+				in.read(&storedText[0], header[0]);
+			if (header[1] > 0)
+				in.read(&result[0], header[1]);
+			if (header[2] > 0)
+				in.read((char*)&partialResult[0], header[2] * sizeof(double));
+		}
+
+		// a removed, damaged or colliding entry is a miss
+		if (!in || storedText.compare(taskText) != 0)
+		{
+			this->totalBytes -= it->second.size;
+			this->entries.erase(it);
+			return false;
+		}
+
+		it->second.lastUse = ++this->useCounter;
+		this->numHits++;
+		return true;
+	}
+
+	void ResultCache::store(const string& taskText, const char* result, size_t length, const vector<double>& partialResult) const
+	{
+		if (taskText.empty())
+			return;
+
+		const string path = this->directory + "/" + fileName(taskText);
+
+		// a name no other process or thread uses
+		stringstream temporarySS;
+#ifdef _WIN32
+		temporarySS << path << "." << GetCurrentProcessId() << "." << std::this_thread::get_id() << ".tmp";
+#else
+		temporarySS << path << "." << getpid() << "." << std::this_thread::get_id() << ".tmp";
+#endif
+		const string temporaryPath = temporarySS.str();
+
+		unsigned long long header[3] = { taskText.length(), length, partialResult.size() };
+		std::ofstream out(temporaryPath.c_str(), std::ios::binary);
+		out.write((const char*)header, sizeof(header));
+		out.write(taskText.c_str(), taskText.length());
+		if (length > 0)
+			out.write(result, length);
+		if (!partialResult.empty())
+			out.write((const char*)&partialResult[0], partialResult.size() * sizeof(double));
+		out.close();
+
+		if (!out || std::rename(temporaryPath.c_str(), path.c_str()) != 0)
+		{
+			cerr << "Could not store the result of a task in '" << path << "'!" << endl;
+			std::remove(temporaryPath.c_str());
+		}
+	}
+
+	void ResultCache::record(const Task& task)
+	{
+		const string taskText = encode(task);
+		if (taskText.empty())
+			return;
+
+		const string name = fileName(taskText);
+
+		std::ifstream in((this->directory + "/" + name).c_str(), std::ios::binary | std::ios::ate);
+		if (!in)
+			return;
+
+		// a new entry starts out empty
+		Entry& entry = this->entries[name];
+		const long long size = in.tellg();
+		this->totalBytes += size - entry.size;
+		entry.size = size;
+		entry.lastUse = ++this->useCounter;
+		this->numStored++;
+
+		evict();
+	}
+
+	void ResultCache::countMiss()
+	{
+		this->numMisses++;
+	}
+
+	void ResultCache::printStatistics(ostream& out) const
+	{
+		const long long numLookups = this->numHits + this->numMisses;
+
+		out << "\tResult cache: " << this->numHits << " hits, " << this->numMisses << " misses";
+		if (numLookups > 0)
+			out << " (hit rate " << (double)this->numHits / numLookups << ")";
+		out << ", " << this->numStored << " stored, " << this->numEvicted << " evicted, " 
+			<< this->entries.size() << " entries (" << this->totalBytes << " of " << this->maxBytes << " bytes)" << endl;
+	}
+
+	string ResultCache::encode(const Task& task)
+	{
+		if (!task.isFileRegion())
+			return task.getCommand() + "\n" + task.getParameters();
+
+		// file IDs depend on the order of registration and the file may change, 
+		// so a region is identified by the path, size and modification time of its file
+		FileRegion region = task.getFileRegion();
+		string path = MPIScheduler::getFilePath(region.fileID);
+		if (path.empty())
+			return "";
+
+		long long size, modificationTime;
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA attributes;
+		if (!GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &attributes))
+			return "";
+		size = ((long long)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+		modificationTime = ((long long)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+		struct stat fileStat;
+		if (stat(path.c_str(), &fileStat) != 0)
+			return "";
+		size = fileStat.st_size;
+		modificationTime = fileStat.st_mtime;
+#endif
+
+		stringstream ss;
+		ss << task.getCommand() << "\n" << path << "\n" << size << "\n" << modificationTime << "\n" << region.offset << "\n" << region.length;
+		return ss.str();
+	}
+
+	string ResultCache::fileName(const string& taskText)
+	{
+		unsigned long long hash = 14695981039346656037ULL;
+		for (size_t i = 0; i < taskText.length(); i++)
+		{
+			hash ^= (unsigned char)taskText[i];
+			hash *= 1099511628211ULL;
+		}
+
+		stringstream nameSS;
+		nameSS << hex << setw(16) << setfill('0') << hash << ".result";
+		return nameSS.str();
+	}
+
+	void ResultCache::evict()
+	{
+		// keep the newest entry even if it alone is too large
+		while (this->totalBytes > this->maxBytes && this->entries.size() > 1)
+		{
+			map<string, Entry>::iterator oldest = this->entries.begin();
+			for (map<string, Entry>::iterator it = this->entries.begin(); it != this->entries.end(); ++it)
+			{
+				if (it->second.lastUse < oldest->second.lastUse)
+					oldest = it;
+			}
+
+			std::remove((this->directory + "/" + oldest->first).c_str());
+			this->totalBytes -= oldest->second.size;
+			this->entries.erase(oldest);
+			this->numEvicted++;
+		}
+	}
+
+
+
+	/*** MPISession ***/
+
+	MPISession::MPISession()
+	{
+		if (MPIScheduler::getProcessID() != 0)
+		{
+			cerr << "Only the master process can begin a session!" << endl;
+			MPIScheduler::abortMPI(1);
+		}
+
+		this->open = true;
+		this->epoch = 0;
+		this->reducePending = false;
+		this->writePending = false;
+		this->batchCostSum = 0;
+		this->numDroppedTasks = 0;
+		this->taskFinishedCallback = NULL;
+
+		// a single process runs the slave function on threads
+		if (MPIScheduler::getNumProcesses() == 1 && MPIScheduler::getNumWorkers() == 0 && MPIScheduler::slaveFunction != NULL)
+		{
+			MPIScheduler::startThreadWorkers();
+			vector<int> threadIDs = MPIScheduler::getWorkerIDs();
+			for (size_t i = 0; i < threadIDs.size(); i++)
+			{
+				this->transport.addWorker(threadIDs[i]);
+			}
+		}
+
+		// every slave starts out available
+		vector<int> workerIDs = MPIScheduler::getWorkerIDs();
+		for (size_t i = 0; i < workerIDs.size(); i++)
+		{
+			this->availableProcesses.push(workerIDs[i]);
+		}
+		this->processTask.assign(MPIScheduler::workers.size(), -1);
+		this->dispatchTimes.assign(MPIScheduler::workers.size(), 0);
+		this->finishTimes.assign(MPIScheduler::workers.size(), MPI_Wtime());
+	}
+
+	MPISession::~MPISession()
+	{
+		if (this->open)
+			close();
+	}
+
+	void MPISession::scheduleTasks(vector<Task> taskList)
+	{
+		for (size_t i = 0; i < taskList.size(); i++)
+		{
+			submit(taskList[i]);
+		}
+
+		scheduleTasks();
+	}
+
+	void MPISession::scheduleTasks()
+	{
+		if (!this->open)
+		{
+			cerr << "Cannot schedule tasks on a closed session!" << endl;
+			return;
+		}
+
+		if (MPIScheduler::getNumWorkers() == 0 && MPIScheduler::elastic.maxSpawnedWorkers <= 0 && MPIScheduler::slaveFunction == NULL)
+		{
+			cerr << "Cannot run master-slave with one process!" << endl;
+			return;
+		}
+
+		// groups that went idle during the last batch may have been idle long enough since
+		retireIdleGroups();
+		runTasks();
+
+		// tell the slaves the batch is done; they stay in their loop
+		Task batchFinish(MPIScheduler::MASTER_BATCH_FINISH_COMMAND);
+		batchFinish.setEpoch(this->epoch);
+		finishBatch(batchFinish);
+	}
+
+	void MPISession::close()
+	{
+		if (!this->open)
+			return;
+
+		// everything finished, so send finish command to all slaves
+		finishBatch(Task(MPIScheduler::MASTER_FINISH_COMMAND));
+		MPIScheduler::stopThreadWorkers();
+
+		// detach the spawned workers, which leave their loop now
+		while (!MPIScheduler::spawnedGroups.empty())
+		{
+			MPI_Comm group = MPIScheduler::spawnedGroups.back();
+			for (size_t i = 1; i < MPIScheduler::workers.size(); i++)
+			{
+				if (MPIScheduler::workers[i].active && MPIScheduler::workers[i].comm == group)
+					this->transport.removeWorker(i);
+			}
+			MPIScheduler::disconnectGroup(group);
+		}
+		this->open = false;
+	}
+
+	int MPISession::getEpoch() const
+	{
+		return this->epoch;
+	}
+
+	bool MPISession::isOpen() const
+	{
+		return this->open;
+	}
+
+	void MPISession::addTaskClass(string name, int priority, double weight, double maxWaitSeconds)
+	{
+		this->queues.addClass(name, priority, weight, maxWaitSeconds);
+	}
+
+	int MPISession::submit(Task task, string taskClass, double cost, string requiredTag)
+	{
+		if (!this->open)
+		{
+			cerr << "Cannot submit tasks to a closed session!" << endl;
+			return -1;
+		}
+
+		// some slave must be able to run the task (unless the first workers are still to be spawned)
+		vector<int> workerIDs = MPIScheduler::getWorkerIDs();
+		bool hasWorker = workerIDs.empty() && MPIScheduler::elastic.maxSpawnedWorkers > 0;
+		for (size_t i = 0; i < workerIDs.size() && !hasWorker; i++)
+		{
+			hasWorker = MPIScheduler::workers[workerIDs[i]].hasTag(requiredTag);
+		}
+		if (!hasWorker)
+		{
+			cerr << "No slave has the tag '" << requiredTag << "' required by task '" << task.getCommand() << "'!" << endl;
+			MPIScheduler::abortMPI(1);
+		}
+
+		int taskID = this->batchTasks.size();
+		task.setTaskID(taskID);
+		this->batchTasks.push_back(task);
+		this->batchResultSizes.push_back(0);
+		this->batchCancelled.push_back(false);
+		this->batchCosts.push_back(cost > 0 ? cost : 1.0);
+		this->batchCostSum += this->batchCosts.back();
+		this->batchTags.push_back(requiredTag);
+
+		// tasks with a memoized result never reach a slave
+		if (MPIScheduler::resultCache.isEnabled() && MPIScheduler::resultCache.contains(task))
+		{
+			this->cachedTasks.push_back(make_pair(taskID, taskClass));
+		}
+		else
+		{
+			if (MPIScheduler::resultCache.isEnabled())
+				MPIScheduler::resultCache.countMiss();
+			this->queues.push(taskID, taskClass, requiredTag);
+		}
+
+		return taskID;
+	}
+
+	void MPISession::setTaskFinishedCallback(TaskFinishedCallback callback)
+	{
+		this->taskFinishedCallback = callback;
+	}
+
+	bool MPISession::cancel(int taskID)
+	{
+		if (taskID < 0 || taskID >= (int)this->batchTasks.size() || this->batchCancelled[taskID])
+			return false;
+
+		// a waiting task never reaches a slave, and a cached one is not finished from the cache
+		bool waiting = this->queues.remove(taskID);
+		for (size_t i = 0; i < this->cachedTasks.size() && !waiting; i++)
+		{
+			if (this->cachedTasks[i].first == taskID)
+			{
+				this->cachedTasks.erase(this->cachedTasks.begin() + i);
+				waiting = true;
+			}
+		}
+		if (waiting)
+		{
+			this->batchCancelled[taskID] = true;
+			this->numDroppedTasks++;
+			cout << "Master dropped cancelled task " << taskID << "." << endl;
+			return true;
+		}
+
+		// the slave running the task finishes it early
+		for (size_t slaveID = 1; slaveID < this->processTask.size(); slaveID++)
+		{
+			if (this->processTask[slaveID] == taskID)
+			{
+				Task cancelTask(MPIScheduler::MASTER_CANCEL_COMMAND);
+				cancelTask.setEpoch(this->epoch);
+				cancelTask.setTaskID(taskID);
+				this->batchCancelled[taskID] = true;
+				cout << "Master is cancelling task " << taskID << " on slave [" << slaveID << "/" << MPIScheduler::getNumProcesses() << "]." << endl;
+				this->transport.sendCancel(slaveID, cancelTask);
+				return true;
+			}
+		}
+
+		// already finished
+		return false;
+	}
+
+	int MPISession::cancelAll()
+	{
+		int numCancelled = 0;
+
+		vector<int> droppedTasks = this->queues.clear();
+		for (size_t i = 0; i < this->cachedTasks.size(); i++)
+		{
+			droppedTasks.push_back(this->cachedTasks[i].first);
+		}
+		this->cachedTasks.clear();
+		for (size_t i = 0; i < droppedTasks.size(); i++)
+		{
+			this->batchCancelled[droppedTasks[i]] = true;
+			this->numDroppedTasks++;
+			numCancelled++;
+		}
+
+		for (size_t slaveID = 1; slaveID < this->processTask.size(); slaveID++)
+		{
+			if (this->processTask[slaveID] >= 0 && cancel(this->processTask[slaveID]))
+				numCancelled++;
+		}
+		cout << "Master cancelled " << numCancelled << " tasks." << endl;
+
+		return numCancelled;
+	}
+
+	void MPISession::printStatistics(ostream& out) const
+	{
+		out << "Statistics of the session after " << this->epoch << " batches:" << endl;
+		this->queues.printStatistics(out);
+	}
+
+	void MPISession::runTasks()
+	{
+		const int numProcesses = MPIScheduler::getNumProcesses();
+		int numFinishedTasks = 0;
+
+		// new batch
+		this->epoch++;
+		this->reducePending = MPIScheduler::reductionEnabled;
+		this->writePending = !MPIScheduler::outputPath.empty();
+
+		if (this->batchTasks.empty())
+		{
+			cout << "No tasks. Nothing to process." << endl;
+			return;
+		}
+
+		// assign as many tasks to processes as possible, all sends start together
+		numFinishedTasks += finishCachedTasks();
+		assignWaitingTasks();
+		double scaleSeconds = scaleWorkers(this->queues.size());
+
+		// wait for messages until all tasks, including ones submitted meanwhile, are assigned and completed (or cancelled)
+		while (numFinishedTasks + this->numDroppedTasks < (int)this->batchTasks.size())
+		{
+			// wake up when an idle spawned group is due to be retired
+			Task task;
+			int messageSource = this->transport.waitForReply(task, scaleSeconds);
+			if (messageSource == MessageTransport::TIMED_OUT)
+			{
+				scaleSeconds = scaleWorkers(this->queues.size());
+				continue;
+			}
+			if (messageSource < 0)
+			{
+				cerr << "Master is waiting for tasks but no slave is working!" << endl;
+				MPIScheduler::abortMPI(1);
+			}
+
+			// if correct (slave finish) message, update state and check what else needs to be done
+			if (task.getCommand().compare(MPIScheduler::SLAVE_FINISH_COMMAND) == 0)
+			{
+				cout << "Master received finished message from slave [" << messageSource << "/" << numProcesses << "]." << endl;
+
+				// get completed task ID
+				int taskID = this->processTask[messageSource];
+
+				// sanity check
+				if (taskID < 0 || taskID >= (int)this->batchTasks.size())
+				{
+					cerr << "Task ID '" << taskID << "' gotten is invalid!" << endl;
+					MPIScheduler::abortMPI(1);
+				}
+
+				// update the speed estimate of the slave
+				WorkerInfo& worker = MPIScheduler::workers[messageSource];
+				double duration = MPI_Wtime() - this->dispatchTimes[messageSource];
+				if (duration > 0)
+					MPIScheduler::updateSpeed(worker.taskSpeed, this->batchCosts[taskID] / duration);
+				worker.numTasks++;
+
+				// size of the result the slave wrote for the task
+				if (!task.getParameters().empty())
+					this->batchResultSizes[taskID] = atoll(task.getParameters().c_str());
+
+				// the slave memoized the result before it replied
+				if (MPIScheduler::resultCache.isEnabled() && !this->batchCancelled[taskID])
+					MPIScheduler::resultCache.record(this->batchTasks[taskID]);
+
+				// update state
+				this->processTask[messageSource] = -1;
+				this->finishTimes[messageSource] = MPI_Wtime();
+				numFinishedTasks++;
+				this->availableProcesses.push(messageSource);
+
+				// the callback may submit more tasks (copy since submitting grows batchTasks)
+				if (this->taskFinishedCallback != NULL && !this->batchCancelled[taskID])
+				{
+					Task finishedTask = this->batchTasks[taskID];
+					this->taskFinishedCallback(*this, taskID, finishedTask);
+				}
+				numFinishedTasks += finishCachedTasks();
+
+				// check if any other tasks need to be processed
+				if (!this->queues.empty())
+					assignWaitingTasks();
+				else
+					cout << (this->batchTasks.size() - numFinishedTasks - this->numDroppedTasks) << " tasks are still being processed..." << endl;
+				scaleSeconds = scaleWorkers(this->queues.size());
+			}
+			else
+			{
+				cerr << "Master got unexpected command '" << task.getCommand() << "' from slave [" << messageSource << "/" << numProcesses << "]." << endl;
+			}
+		}
+		cout << "All tasks are finished!" << endl;
+
+		this->batchTasks.clear();
+		this->batchCosts.clear();
+		this->batchTags.clear();
+		this->batchCancelled.clear();
+		this->cachedTasks.clear();
+		this->batchCostSum = 0;
+		this->numDroppedTasks = 0;
+	}
+
+	void MPISession::assignWaitingTasks()
+	{
+		// idle slaves, fastest first if speeds are used
+		vector< pair<double, int> > idleSlaves;
+		while (!this->availableProcesses.empty())
+		{
+			int slaveID = this->availableProcesses.front();
+			this->availableProcesses.pop();
+			double speed = MPIScheduler::speedAware ? MPIScheduler::workers[slaveID].taskSpeed : 0;
+			idleSlaves.push_back(make_pair(-speed, slaveID));
+		}
+		stable_sort(idleSlaves.begin(), idleSlaves.end());
+
+		for (size_t i = 0; i < idleSlaves.size(); i++)
+		{
+			int slaveID = idleSlaves[i].second;
+
+			// get a task this slave can run
+			int classIndex, position;
+			int taskID = this->queues.peek(MPIScheduler::workers[slaveID], classIndex, position);
+			if (taskID < 0 || (MPIScheduler::speedAware && shouldLeaveToFasterSlave(slaveID, taskID)))
+			{
+				this->availableProcesses.push(slaveID);
+				continue;
+			}
+			this->queues.take(classIndex, position);
+
+			// assign task to available process by sending message to slave
+			assignTask(slaveID, this->batchTasks[taskID]);
+			this->processTask[slaveID] = taskID;
+			this->dispatchTimes[slaveID] = MPI_Wtime();
+		}
+		this->transport.flush();
+	}
+
+	int MPISession::finishCachedTasks()
+	{
+		int numFinished = 0;
+
+		// the callback may submit more tasks, some of them cached
+		while (!this->cachedTasks.empty())
+		{
+			int taskID = this->cachedTasks.front().first;
+			string taskClass = this->cachedTasks.front().second;
+			this->cachedTasks.erase(this->cachedTasks.begin());
+
+			string result;
+			vector<double> partialResult;
+			bool usable = MPIScheduler::resultCache.load(this->batchTasks[taskID], result, partialResult) 
+				&& (!MPIScheduler::reductionEnabled || partialResult.size() == MPIScheduler::reductionIdentity.size());
+			if (!usable)
+			{
+				MPIScheduler::resultCache.countMiss();
+				this->queues.push(taskID, taskClass, this->batchTags[taskID]);
+				continue;
+			}
+			cout << "Master found the result of task " << taskID << " in the result cache." << endl;
+
+			// the master writes the result with its own (empty) part of the ordered output
+			if (this->writePending && !result.empty())
+			{
+				MPIScheduler::currentTaskID = taskID;
+				MPIScheduler::slaveWriteResult(result);
+				MPIScheduler::currentTaskID = -1;
+				MPIScheduler::currentResultLength = 0;
+			}
+			this->batchResultSizes[taskID] = result.length();
+
+			// and folds the partial result into its accumulator, which joins the reduction
+			if (MPIScheduler::reductionEnabled)
+				MPIScheduler::reductionCombine(&partialResult[0], &MPIScheduler::reductionAccumulator[0], partialResult.size());
+
+			numFinished++;
+			if (this->taskFinishedCallback != NULL)
+			{
+				Task finishedTask = this->batchTasks[taskID];
+				this->taskFinishedCallback(*this, taskID, finishedTask);
+			}
+		}
+
+		return numFinished;
+	}
+
+	bool MPISession::shouldLeaveToFasterSlave(int slaveID, int taskID) const
+	{
+		const double speed = MPIScheduler::workers[slaveID].taskSpeed;
+		const double cost = this->batchCosts[taskID];
+		const double now = MPI_Wtime();
+
+		if (speed <= 0)
+			return false;
+
+		// busy slaves that are faster and could run the task
+		vector<int> fasterSlaves;
+		for (size_t i = 1; i < this->processTask.size(); i++)
+		{
+			const WorkerInfo& worker = MPIScheduler::workers[i];
+			if (this->processTask[i] >= 0 && worker.taskSpeed > speed && worker.hasTag(this->batchTags[taskID]))
+				fasterSlaves.push_back(i);
+		}
+
+		// only the tail of the batch is left to faster slaves
+		if (this->queues.size() > (int)fasterSlaves.size())
+			return false;
+
+		// would a faster slave finish its current task and this one sooner?
+		const double finishTime = now + cost / speed;
+		for (size_t i = 0; i < fasterSlaves.size(); i++)
+		{
+			int fasterID = fasterSlaves[i];
+			const double fasterSpeed = MPIScheduler::workers[fasterID].taskSpeed;
+			double fasterFree = this->dispatchTimes[fasterID] + this->batchCosts[this->processTask[fasterID]] / fasterSpeed;
+			if (fasterFree < now)
+				fasterFree = now;
+
+			if (fasterFree + cost / fasterSpeed < finishTime)
+				return true;
+		}
+
+		return false;
+	}
+
+	double MPISession::scaleWorkers(int numWaitingTasks)
+	{
+		MPIScheduler::ElasticScaling& elastic = MPIScheduler::elastic;
+		vector<WorkerInfo>& workers = MPIScheduler::workers;
+
+		if (elastic.maxSpawnedWorkers <= 0 || !MPIScheduler::threadWorkers.empty())
+			return -1;
+
+		// retire idle spawned groups once the backlog has drained (unless they hold 
+		// results that are written at the end of the batch; finishBatch() checks again)
+		if (numWaitingTasks == 0)
+			return this->writePending ? -1 : retireIdleGroups();
+
+		// size and measured throughput of the current pool
+		vector<int> workerIDs = MPIScheduler::getWorkerIDs();
+		int numSpawned = 0;
+		double throughput = 0;
+		for (size_t i = 0; i < workerIDs.size(); i++)
+		{
+			if (workers[workerIDs[i]].comm != MPI_COMM_WORLD)
+				numSpawned++;
+			throughput += workers[workerIDs[i]].taskSpeed;
+		}
+		if (numSpawned + elastic.workersPerSpawn > elastic.maxSpawnedWorkers)
+			return -1;
+
+		// grow when every worker has a long queue that would take the pool long to drain
+		if (!workerIDs.empty())
+		{
+			if (numWaitingTasks < elastic.growBacklogPerWorker * workerIDs.size())
+				return -1;
+
+			double meanCost = this->batchCostSum / this->batchTasks.size();
+			if (throughput <= 0 || numWaitingTasks * meanCost / throughput < elastic.growDrainSeconds)
+				return -1;
+		}
+
+		vector<int> newIDs = MPIScheduler::spawnWorkers(elastic.workersPerSpawn);
+		if (newIDs.empty())
+		{
+			cerr << "Elastic scaling is disabled." << endl;
+			elastic.maxSpawnedWorkers = 0;
+			return -1;
+		}
+
+		this->processTask.resize(workers.size(), -1);
+		this->dispatchTimes.resize(workers.size(), 0);
+		this->finishTimes.resize(workers.size(), MPI_Wtime());
+		for (size_t i = 0; i < newIDs.size(); i++)
+		{
+			this->transport.addWorker(newIDs[i]);
+			this->availableProcesses.push(newIDs[i]);
+		}
+		assignWaitingTasks();
+
+		return -1;
+	}
+
+	double MPISession::retireIdleGroups()
+	{
+		const vector<WorkerInfo>& workers = MPIScheduler::workers;
+		const double now = MPI_Wtime();
+		double nextDue = -1;
+
+		if (MPIScheduler::elastic.maxSpawnedWorkers <= 0)
+			return -1;
+
+		for (size_t i = MPIScheduler::spawnedGroups.size(); i-- > 0; )
+		{
+			// a group is idle since the last of its workers finished
+			MPI_Comm group = MPIScheduler::spawnedGroups[i];
+			bool idle = true;
+			double idleSince = 0;
+			for (size_t j = 1; j < workers.size() && idle; j++)
+			{
+				if (!workers[j].active || workers[j].comm != group)
+					continue;
+				if (this->processTask[j] >= 0)
+					idle = false;
+				idleSince = max(idleSince, this->finishTimes[j]);
+			}
+			if (!idle)
+				continue;
+
+			double due = idleSince + MPIScheduler::elastic.retireIdleSeconds - now;
+			if (due <= 0)
+				retireGroup(group);
+			else if (nextDue < 0 || due < nextDue)
+				nextDue = due;
+		}
+
+		return nextDue;
+	}
+
+	void MPISession::retireGroup(MPI_Comm group)
+	{
+		const vector<WorkerInfo>& workers = MPIScheduler::workers;
+
+		// the retired workers are no longer available
+		queue<int> availableProcesses;
+		while (!this->availableProcesses.empty())
+		{
+			int slaveID = this->availableProcesses.front();
+			this->availableProcesses.pop();
+			if (workers[slaveID].comm != group)
+				availableProcesses.push(slaveID);
+		}
+		this->availableProcesses.swap(availableProcesses);
+
+		// the workers leave their loop, after joining a reduction of their partial results if needed
+		Task finish(MPIScheduler::MASTER_FINISH_COMMAND, this->reducePending ? MPIScheduler::REDUCE_PARAMETER : "");
+		vector<int> groupIDs;
+		for (size_t i = 1; i < workers.size(); i++)
+		{
+			if (workers[i].active && workers[i].comm == group)
+			{
+				cout << "Master is retiring spawned worker [" << i << "/" << MPIScheduler::getNumProcesses() << "]." << endl;
+				this->transport.send(i, finish, false);
+				groupIDs.push_back(i);
+			}
+		}
+		this->transport.flush();
+		for (size_t i = 0; i < groupIDs.size(); i++)
+		{
+			this->transport.removeWorker(groupIDs[i]);
+		}
+
+		if (this->reducePending)
+			MPIScheduler::reduceGroupAccumulators(group);
+		MPIScheduler::disconnectGroup(group);
+	}
+
+	void MPISession::assignTask(int slaveID, Task task)
+	{
+		const int numProcesses = MPIScheduler::getNumProcesses();
+
+		// tag task with the current batch
+		task.setEpoch(this->epoch);
+
+		cout << "Master is assigning task to slave [" << slaveID << "/" << numProcesses << "]." << endl;
+		this->transport.send(slaveID, task, true);
+	}
+
+	void MPISession::notifySlaves(Task task)
+	{
+		const int numProcesses = MPIScheduler::getNumProcesses();
+		vector<int> workerIDs = MPIScheduler::getWorkerIDs();
+
+		for (size_t i = 0; i < workerIDs.size(); i++)
+		{
+			int slaveID = workerIDs[i];
+			cout << "Master is sending slave [" << slaveID << "/" << numProcesses << "] the " << task.getCommand() << " command." << endl;
+			this->transport.send(slaveID, task, false);
+		}
+		this->transport.flush();
+		this->transport.waitForSends();
+	}
+
+	void MPISession::finishBatch(Task task)
+	{
+		// slaves join the reduction and the write when they get the finish command
+		vector<string> paramList;
+		if (this->reducePending)
+			paramList.push_back(MPIScheduler::REDUCE_PARAMETER);
+		if (this->writePending)
+			paramList.push_back(MPIScheduler::WRITE_PARAMETER);
+
+		Task finishTask(task.getCommand(), ParameterTools::constructParameterString(paramList));
+		finishTask.setEpoch(task.getEpoch());
+		if (!MPIScheduler::threadWorkers.empty() && !paramList.empty())
+		{
+			// slave threads hand their parts over in memory; wait until all of them did
+			vector<int> workerIDs = MPIScheduler::getWorkerIDs();
+			for (size_t i = 0; i < workerIDs.size(); i++)
+			{
+				this->transport.send(workerIDs[i], finishTask, true);
+			}
+			Task reply;
+			for (size_t i = 0; i < workerIDs.size(); i++)
+			{
+				this->transport.waitForReply(reply);
+			}
+		}
+		else
+		{
+			notifySlaves(finishTask);
+		}
+
+		if (this->reducePending)
+			MPIScheduler::reduceAccumulators();
+		if (this->writePending)
+			MPIScheduler::writeOrderedOutput(this->batchResultSizes);
+		this->reducePending = false;
+		this->writePending = false;
+		this->batchResultSizes.clear();
+
+		// the results of idle groups are written now, so they can go
+		if (task.getCommand().compare(MPIScheduler::MASTER_BATCH_FINISH_COMMAND) == 0)
+			retireIdleGroups();
+	}
+
+
+
+	/*** MPIPipeline ***/
+
+	const int MPIPipeline::REQUEST_TAG = 1;
+	const int MPIPipeline::GRANT_TAG = 2;
+	const int MPIPipeline::DATA_TAG = 3;
+	const int MPIPipeline::DONE_TAG = 4;
+	const int MPIPipeline::END_TAG = 5;
+
+	MPIPipeline::MPIPipeline(const vector<int>& stageSizes, int queueCapacity)
+	{
+		const int numProcesses = MPIScheduler::getNumProcesses();
+		const int rank = MPIScheduler::getProcessID();
+
+		// consecutive groups of processes, each with a scheduler and at least one worker
+		this->stageFirst.push_back(0);
+		for (size_t i = 0; i < stageSizes.size(); i++)
+		{
+			if (stageSizes[i] < 2)
+			{
+				cerr << "Stage " << i << " of the pipeline needs a scheduler and at least one worker!" << endl;
+				MPIScheduler::abortMPI(1);
+			}
+			this->stageFirst.push_back(this->stageFirst.back() + stageSizes[i]);
+		}
+		if (stageSizes.empty() || this->stageFirst.back() != numProcesses)
+		{
+			cerr << "The stages of the pipeline have " << this->stageFirst.back() << " processes but there are " << numProcesses << "!" << endl;
+			MPIScheduler::abortMPI(1);
+		}
+
+		this->stage = 0;
+		while (rank >= this->stageFirst[this->stage + 1])
+			this->stage++;
+
+		this->stageFunctions.assign(stageSizes.size(), NULL);
+		this->queueCapacity = queueCapacity < 1 ? 1 : queueCapacity;
+		this->numItems = 0;
+		this->numEmitted = 0;
+		this->waitSeconds = 0;
+		if (isStageScheduler())
+			this->outstanding.assign(stageSizes[this->stage] - 1, 0);
+
+		// own communicator for the pipeline messages, and one per stage with the scheduler as rank 0
+		MPI_Comm_dup(MPI_COMM_WORLD, &this->pipelineComm);
+		MPI_Comm_split(MPI_COMM_WORLD, this->stage, rank, &this->stageComm);
+	}
+
+	MPIPipeline::~MPIPipeline()
+	{
+		freeCommunicators();
+	}
+
+	void MPIPipeline::setStageFunction(int stage, StageFunction function)
+	{
+		if (stage < 0 || stage >= (int)this->stageFunctions.size())
+		{
+			cerr << "The pipeline has no stage " << stage << "!" << endl;
+			return;
+		}
+
+		this->stageFunctions[stage] = function;
+	}
+
+	void MPIPipeline::submit(const string& item)
+	{
+		if (MPIScheduler::getProcessID() != 0)
+		{
+			cerr << "Only process 0 can submit items to the pipeline!" << endl;
+			return;
+		}
+
+		// wait for room in stage 0
+		double startTime = MPI_Wtime();
+		int workerRank;
+		int numProducers = 0;
+		while ((workerRank = findWorkerWithRoom()) < 0)
+		{
+			MPI_Status status;
+			MPI_Recv(NULL, 0, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, this->pipelineComm, &status);
+			handleMessage(status, numProducers);
+		}
+		this->waitSeconds += MPI_Wtime() - startTime;
+
+		this->outstanding[workerRank - this->stageFirst[0] - 1]++;
+		this->numItems++;
+		MPI_Send(const_cast<char*>(item.data()), item.length(), MPI_CHAR, workerRank, DATA_TAG, this->pipelineComm);
+	}
+
+	void MPIPipeline::emit(const string& item)
+	{
+		if (isStageScheduler() || this->stage + 1 >= (int)this->stageFunctions.size())
+		{
+			cerr << "Only the workers of a stage that is not the last can emit items!" << endl;
+			MPIScheduler::abortMPI(1);
+		}
+
+		// ask the scheduler of the next stage for room; this blocks while the next stage is full
+		const int nextScheduler = this->stageFirst[this->stage + 1];
+		double startTime = MPI_Wtime();
+		int workerRank;
+		MPI_Send(NULL, 0, MPI_INT, nextScheduler, REQUEST_TAG, this->pipelineComm);
+		MPI_Recv(&workerRank, 1, MPI_INT, nextScheduler, GRANT_TAG, this->pipelineComm, MPI_STATUS_IGNORE);
+		this->waitSeconds += MPI_Wtime() - startTime;
+
+		// the item goes straight to the worker
+		MPI_Send(const_cast<char*>(item.data()), item.length(), MPI_CHAR, workerRank, DATA_TAG, this->pipelineComm);
+		this->numEmitted++;
+	}
+
+	void MPIPipeline::run()
+	{
+		if (this->pipelineComm == MPI_COMM_NULL)
+		{
+			cerr << "The pipeline already ran!" << endl;
+			return;
+		}
+
+		if (isStageScheduler())
+		{
+			// stage 0 is fed by submit(); the workers of the previous stage feed the others
+			int numProducers = this->stage == 0 ? 0 : this->stageFirst[this->stage] - this->stageFirst[this->stage - 1] - 1;
+			runScheduler(numProducers);
+		}
+		else
+		{
+			if (this->stageFunctions[this->stage] == NULL)
+			{
+				cerr << "No function was set for stage " << this->stage << " of the pipeline!" << endl;
+				MPIScheduler::abortMPI(1);
+			}
+			runWorker();
+		}
+
+		freeCommunicators();
+	}
+
+	int MPIPipeline::getStage() const
+	{
+		return this->stage;
+	}
+
+	bool MPIPipeline::isStageScheduler() const
+	{
+		return MPIScheduler::getProcessID() == this->stageFirst[this->stage];
+	}
+
+	MPI_Comm MPIPipeline::getStageComm() const
+	{
+		return this->stageComm;
+	}
+
+	void MPIPipeline::printStatistics(ostream& out) const
+	{
+		out << "Pipeline process [" << MPIScheduler::getProcessID() << "/" << MPIScheduler::getNumProcesses() << "], stage " << this->stage;
+		if (isStageScheduler())
+			out << " scheduler: " << this->numItems << " items scheduled";
+		else
+			out << " worker: " << this->numItems << " items processed, " << this->numEmitted << " items emitted";
+		out << ", waited " << this->waitSeconds << "s for room to pass items on" << endl;
+	}
+
+	void MPIPipeline::runScheduler(int numProducers)
+	{
+		const int first = this->stageFirst[this->stage];
+		queue<int> waitingProducers;
+
+		while (true)
+		{
+			// grant room to waiting producers
+			while (!waitingProducers.empty())
+			{
+				int workerRank = findWorkerWithRoom();
+				if (workerRank < 0)
+					break;
+
+				MPI_Send(&workerRank, 1, MPI_INT, waitingProducers.front(), GRANT_TAG, this->pipelineComm);
+				waitingProducers.pop();
+				this->outstanding[workerRank - first - 1]++;
+				this->numItems++;
+			}
+
+			// the stage is done when every producer ended and every item was processed
+			bool idle = numProducers == 0 && waitingProducers.empty();
+			for (size_t i = 0; i < this->outstanding.size() && idle; i++)
+			{
+				idle = this->outstanding[i] == 0;
+			}
+			if (idle)
+				break;
+
+			MPI_Status status;
+			MPI_Recv(NULL, 0, MPI_INT, MPI_ANY_SOURCE, MPI_ANY_TAG, this->pipelineComm, &status);
+			if (status.MPI_TAG == REQUEST_TAG)
+				waitingProducers.push(status.MPI_SOURCE);
+			else
+				handleMessage(status, numProducers);
+		}
+
+		// stop the workers
+		for (size_t i = 0; i < this->outstanding.size(); i++)
+		{
+			MPI_Send(NULL, 0, MPI_INT, first + 1 + i, END_TAG, this->pipelineComm);
+		}
+	}
+
+	void MPIPipeline::runWorker()
+	{
+		const int scheduler = this->stageFirst[this->stage];
+
+		while (true)
+		{
+			MPI_Status status;
+			MPI_Probe(MPI_ANY_SOURCE, MPI_ANY_TAG, this->pipelineComm, &status);
+			if (status.MPI_TAG == END_TAG)
+			{
+				MPI_Recv(NULL, 0, MPI_INT, status.MPI_SOURCE, END_TAG, this->pipelineComm, MPI_STATUS_IGNORE);
+				break;
+			}
+
+			// receive the item directly from its producer
+			int length;
+			MPI_Get_count(&status, MPI_CHAR, &length);
+			string item(length, '\0');
+			MPI_Recv(&item[0], length, MPI_CHAR, status.MPI_SOURCE, DATA_TAG, this->pipelineComm, MPI_STATUS_IGNORE);
+
+			this->stageFunctions[this->stage](*this, item);
+			this->numItems++;
+
+			MPI_Send(NULL, 0, MPI_INT, scheduler, DONE_TAG, this->pipelineComm);
+		}
+
+		// this worker produces no more items for the next stage
+		if (this->stage + 1 < (int)this->stageFunctions.size())
+			MPI_Send(NULL, 0, MPI_INT, this->stageFirst[this->stage + 1], END_TAG, this->pipelineComm);
+	}
+
+	int MPIPipeline::findWorkerWithRoom() const
+	{
+		int best = -1;
+		for (size_t i = 0; i < this->outstanding.size(); i++)
+		{
+			if (this->outstanding[i] < this->queueCapacity && (best < 0 || this->outstanding[i] < this->outstanding[best]))
+				best = i;
+		}
+
+		return best < 0 ? -1 : this->stageFirst[this->stage] + 1 + best;
+	}
+
+	void MPIPipeline::handleMessage(const MPI_Status& status, int& numProducers)
+	{
+		if (status.MPI_TAG == DONE_TAG)
+			this->outstanding[status.MPI_SOURCE - this->stageFirst[this->stage] - 1]--;
+		else if (status.MPI_TAG == END_TAG)
+			numProducers--;
+		else
+			cerr << "Pipeline scheduler got an unexpected message with tag " << status.MPI_TAG << "!" << endl;
+	}
+
+	void MPIPipeline::freeCommunicators()
+	{
+		if (this->pipelineComm == MPI_COMM_NULL)
+			return;
+
+		MPI_Comm_free(&this->pipelineComm);
+		MPI_Comm_free(&this->stageComm);
+	}
+
+
+
+	/*** TaskQueues ***/
+
+	const string TaskQueues::DEFAULT_CLASS = "default";
+	const double TaskQueues::DEFAULT_MAX_WAIT_SECONDS = 30.0;
+
+	TaskQueues::TaskQueues()
+	{
+		this->numWaiting = 0;
+		addClass(DEFAULT_CLASS, 0, 1.0, DEFAULT_MAX_WAIT_SECONDS);
+	}
+
+	void TaskQueues::addClass(string name, int priority, double weight, double maxWaitSeconds)
+	{
+		if (weight <= 0)
+		{
+			cerr << "Task class '" << name << "' needs a positive weight!" << endl;
+			MPIScheduler::abortMPI(1);
+		}
+
+		int index = findClass(name);
+		if (index < 0)
+		{
+			TaskClass taskClass;
+			taskClass.name = name;
+			taskClass.virtualTime = 0;
+			this->classes.push_back(taskClass);
+			index = this->classes.size() - 1;
+		}
+
+		TaskClass& taskClass = this->classes[index];
+		taskClass.priority = priority;
+		taskClass.weight = weight;
+		taskClass.maxWaitSeconds = maxWaitSeconds;
+	}
+
+	void TaskQueues::push(int taskID, string className, string requiredTag)
+	{
+		int index = findClass(className);
+		if (index < 0)
+		{
+			cerr << "Unknown task class '" << className << "'!" << endl;
+			MPIScheduler::abortMPI(1);
+		}
+
+		// a class that was idle does not get credit for the time it was idle
+		TaskClass& taskClass = this->classes[index];
+		if (taskClass.waiting.empty())
+		{
+			for (size_t i = 0; i < this->classes.size(); i++)
+			{
+				const TaskClass& other = this->classes[i];
+				if (!other.waiting.empty() && other.priority == taskClass.priority && other.virtualTime > taskClass.virtualTime)
+					taskClass.virtualTime = other.virtualTime;
+			}
+		}
+
+		WaitingTask task;
+		task.taskID = taskID;
+		task.submitTime = MPI_Wtime();
+		task.requiredTag = requiredTag;
+		taskClass.waiting.push_back(task);
+		this->numWaiting++;
+	}
+
+	int TaskQueues::peek(const WorkerInfo& worker, int& classIndex, int& position) const
+	{
+		if (this->numWaiting == 0)
+			return -1;
+
+		const double now = MPI_Wtime();
+		vector<int> eligible(this->classes.size(), -1); // oldest task of each class the worker can get
+		int chosen = -1;
+
+		for (size_t i = 0; i < this->classes.size(); i++)
+		{
+			eligible[i] = findEligible(this->classes[i], worker);
+		}
+
+		// starvation protection: the class whose oldest task is most overdue
+		double mostOverdue = 0;
+		for (size_t i = 0; i < this->classes.size(); i++)
+		{
+			const TaskClass& taskClass = this->classes[i];
+			if (eligible[i] < 0 || taskClass.maxWaitSeconds <= 0)
+				continue;
+
+			double overdue = now - taskClass.waiting[eligible[i]].submitTime - taskClass.maxWaitSeconds;
+			if (overdue >= 0 && (chosen < 0 || overdue > mostOverdue))
+			{
+				chosen = i;
+				mostOverdue = overdue;
+			}
+		}
+
+		// otherwise the highest priority, and among those the class with the smallest weighted share
+		if (chosen < 0)
+		{
+			for (size_t i = 0; i < this->classes.size(); i++)
+			{
+				const TaskClass& taskClass = this->classes[i];
+				if (eligible[i] < 0)
+					continue;
+
+				if (chosen < 0 
+					|| taskClass.priority > this->classes[chosen].priority 
+					|| (taskClass.priority == this->classes[chosen].priority && taskClass.virtualTime < this->classes[chosen].virtualTime))
+				{
+					chosen = i;
+				}
+			}
+		}
+
+		if (chosen < 0)
+			return -1;
+
+		classIndex = chosen;
+		position = eligible[chosen];
+		return this->classes[chosen].waiting[position].taskID;
 	}
 
-	void MPIScheduler::synchronize()
+	void TaskQueues::take(int classIndex, int position)
 	{
-		stringstream ssMasterMessage;
-		ssMasterMessage << MPIScheduler::SYNCHRONIZATION_MASTER_MESSAGE << MPIScheduler::syncCounter;
+		TaskClass& taskClass = this->classes[classIndex];
+		const WaitingTask& task = taskClass.waiting[position];
 
-		stringstream ssSlaveMessage;
-		ssSlaveMessage << MPIScheduler::SYNCHRONIZATION_SLAVE_MESSAGE << MPIScheduler::syncCounter;
+		taskClass.waitTimes.push_back(MPI_Wtime() - task.submitTime);
+		taskClass.virtualTime += 1.0 / taskClass.weight;
+		taskClass.waiting.erase(taskClass.waiting.begin() + position);
+		this->numWaiting--;
+	}
 
-		synchronize(ssMasterMessage.str(), ssSlaveMessage.str());
+	int TaskQueues::pop(const WorkerInfo& worker)
+	{
+		int classIndex, position;
+		int taskID = peek(worker, classIndex, position);
+		if (taskID >= 0)
+			take(classIndex, position);
 
-		MPIScheduler::syncCounter++;
+		return taskID;
 	}
 
-	void MPIScheduler::synchronize(string slaveBroadcastMsg, string masterBroadcastMsg)
+	bool TaskQueues::remove(int taskID)
 	{
-		masterWait(slaveBroadcastMsg);
-		slavesWait(masterBroadcastMsg);
+		for (size_t i = 0; i < this->classes.size(); i++)
+		{
+			deque<WaitingTask>& waiting = this->classes[i].waiting;
+			for (size_t position = 0; position < waiting.size(); position++)
+			{
+				if (waiting[position].taskID == taskID)
+				{
+					waiting.erase(waiting.begin() + position);
+					this->numWaiting--;
+					return true;
+				}
+			}
+		}
+
+		return false;
 	}
 
-	void MPIScheduler::masterWait(string slaveBroadcastMsg)
+	vector<int> TaskQueues::clear()
 	{
-		// receive buffer
-		char recvbuff[MAX_MESSAGE_SIZE];
-		const char* SLAVEBROADCASTMSG = slaveBroadcastMsg.c_str();
-		const int SLAVEBROADCASTMSG_SIZE = slaveBroadcastMsg.length();
-
-		// master needs to wait here until all slaves reaches here
-		const int numProcesses = getNumProcesses();
-		const int rank = getProcessID();
-		if (rank == 0)
+		vector<int> taskIDs;
+		for (size_t i = 0; i < this->classes.size(); i++)
 		{
-			cout << "Master process [" << rank << "/" << numProcesses << "] is waiting to get " << slaveBroadcastMsg << " message from all slaves..." << endl;
-
-			// wait until all slaves are done
-			bool finish[MAX_NUM_PROCESSES];
-			finish[0] = true;
-			for (int i = 1; i < numProcesses; i++)
+			deque<WaitingTask>& waiting = this->classes[i].waiting;
+			for (size_t position = 0; position < waiting.size(); position++)
 			{
-				finish[i] = false;
+				taskIDs.push_back(waiting[position].taskID);
 			}
+			waiting.clear();
+		}
+		this->numWaiting = 0;
 
-			// master process is now waiting for all slave processes to finish
-			while (true)
-			{
-				if (numProcesses <= 1)
-					break;
+		return taskIDs;
+	}
 
-				int msgFlag = 0;
-				MPI_Iprobe(MPI_ANY_SOURCE, MPI_ANY_TAG, MPI_COMM_WORLD, &msgFlag, MPIScheduler::mpiStatus);
+	bool TaskQueues::empty() const
+	{
+		return this->numWaiting == 0;
+	}
 
-				// if a messsage is available
-				if (msgFlag)
-				{
-					// get the message tag and especially source
-					int messageID = (*MPIScheduler::mpiStatus).MPI_TAG;
-					int messageSource = (*MPIScheduler::mpiStatus).MPI_SOURCE;
-					cout << "A message from process [" << messageSource << "/" << numProcesses << "]." << endl;
+	int TaskQueues::size() const
+	{
+		return this->numWaiting;
+	}
 
-					// receive the message into the buffer and check if it is the correct command
-					int ierr = MPI_Recv(recvbuff, SLAVEBROADCASTMSG_SIZE, MPI_CHAR, messageSource, 0, MPI_COMM_WORLD, MPIScheduler::mpiStatus);
+	void TaskQueues::printStatistics(ostream& out) const
+	{
+		const double PERCENTILES[] = { 0.5, 0.9, 0.99 };
+		const int NUM_PERCENTILES = 3;
 
-					// check if correct message
-					bool correctMessage = true;
-					for (int i = 0; i < SLAVEBROADCASTMSG_SIZE; i++)
-					{
-						if (recvbuff[i] != slaveBroadcastMsg[i])
-						{
-							correctMessage = false;
-							break;
-						}
-					}
+		for (size_t i = 0; i < this->classes.size(); i++)
+		{
+			const TaskClass& taskClass = this->classes[i];
+			const int numServed = taskClass.waitTimes.size();
 
-					if (correctMessage)
-					{
-						cout << "Received " << slaveBroadcastMsg << " message from process [" << messageSource << "/" << numProcesses << "]." << endl;
-						finish[messageSource] = true;
+			out << "\tTask class '" << taskClass.name << "' (priority " << taskClass.priority << ", weight " << taskClass.weight 
+				<< "): " << numServed << " tasks";
+			if (numServed > 0)
+			{
+				vector<double> waitTimes = taskClass.waitTimes;
+				sort(waitTimes.begin(), waitTimes.end());
 
-						// test if every process is finished
-						bool allFinish = true;
-						for (int i = 1; i < numProcesses; i++)
-						{
-							if (!finish[i])
-							{
-								cout << "Process [" << i << "/" << numProcesses << "] is still not here yet..." << endl;
-								allFinish = false;
-							}
-						}
-						if (allFinish)
-						{
-							break;
-						}
-						cout << "Still waiting for all slaves to get here with the master..." << endl;
-					}
+				out << ", wait time";
+				for (int p = 0; p < NUM_PERCENTILES; p++)
+				{
+					// nearest rank
+					int rank = (int)ceil(PERCENTILES[p] * numServed) - 1;
+					out << " p" << (int)(PERCENTILES[p] * 100) << "=" << waitTimes[rank < 0 ? 0 : rank] << "s";
 				}
+				out << " max=" << waitTimes.back() << "s";
 			}
-
-			// MASTER CAN DO STUFF HERE BEFORE SLAVES PROCEED
-
-			cout << "Master process [" << rank << "/" << numProcesses << "] has continued..." << endl;
+			out << endl;
 		}
-		else
-		{
-			cout << "Slave process [" << rank << "/" << numProcesses << "] is sending arrival message " << SLAVEBROADCASTMSG << " to master..." << endl;
-
-			// send finish heuristic learning message to master
-			int ierr = MPI_Send(const_cast<char*>(SLAVEBROADCASTMSG), SLAVEBROADCASTMSG_SIZE, MPI_CHAR, 0, 0, MPI_COMM_WORLD);
+	}
 
-			cout << "Slave process [" << rank << "/" << numProcesses << "] has continued..." << endl;
+	int TaskQueues::findEligible(const TaskClass& taskClass, const WorkerInfo& worker) const
+	{
+		for (size_t i = 0; i < taskClass.waiting.size(); i++)
+		{
+			if (worker.hasTag(taskClass.waiting[i].requiredTag))
+				return i;
 		}
+
+		return -1;
 	}
 
-	void MPIScheduler::slavesWait(string masterBroadcastMsg)
+	int TaskQueues::findClass(string name) const
 	{
-		// receive buffer
-		char recvbuff[MAX_MESSAGE_SIZE];
-		const char* MASTERBROADCASTMSG = masterBroadcastMsg.c_str();
-		const int MASTERBROADCASTMSG_SIZE = masterBroadcastMsg.length();
-
-		// slaves need to wait here until master reaches here
-		const int numProcesses = getNumProcesses();
-		const int rank = getProcessID();
-		if (rank == 0)
+		for (size_t i = 0; i < this->classes.size(); i++)
 		{
-			cout << "Master process [" << rank << "/" << numProcesses << "] is telling slave processes to continue..." << endl;
+			if (this->classes[i].name.compare(name) == 0)
+				return i;
+		}
 
-			// tell each slave to continue
-			for (int j = 1; j < numProcesses; j++)
-			{
-				cout << "Master is sending slave process [" << j << "/" << numProcesses << "] the " << MASTERBROADCASTMSG << " message to continue..." << endl;
-				int ierr = MPI_Send(const_cast<char*>(MASTERBROADCASTMSG), MASTERBROADCASTMSG_SIZE, MPI_CHAR, j, 0, MPI_COMM_WORLD);
-			}
+		return -1;
+	}
 
-			cout << "Master process [" << rank << "/" << numProcesses << "] is released..." << endl;
-		}
-		else
-		{
-			cout << "Slave process [" << rank << "/" << numProcesses << "] is waiting for master..." << endl;
 
-			// now wait until master gives the continue signal
-			while (true)
-			{
-				int ierr = MPI_Recv(recvbuff, MASTERBROADCASTMSG_SIZE, MPI_CHAR, 0, 0, MPI_COMM_WORLD, MPIScheduler::mpiStatus);
 
-				// check if correct message
-				bool correctMessage = true;
-				for (int i = 0; i < MASTERBROADCASTMSG_SIZE; i++)
-				{
-					if (recvbuff[i] != masterBroadcastMsg.at(i))
-					{
-						correctMessage = false;
-						break;
-					}
-				}
+	/*** WorkerInfo ***/
 
-				if (correctMessage)
-				{
-					cout << "Slave process [" << rank << "/" << numProcesses << "] got the " << masterBroadcastMsg << " message." << endl;
-					break;
-				}
-			}
+	bool WorkerInfo::hasTag(string tag) const
+	{
+		if (tag.empty())
+			return true;
 
-			cout << "Slave process [" << rank << "/" << numProcesses << "] is released..." << endl;
+		for (size_t i = 0; i < this->tags.size(); i++)
+		{
+			if (this->tags[i].compare(tag) == 0)
+				return true;
 		}
+
+		return false;
 	}
 
 
 
 	/*** Task ***/
 
+	const string Task::FILE_REGION_PARAMETER = "FILEREGION";
 	const char Task::MESSAGE_DELIMITER = ';';
 	const char Task::MESSAGE_BEGIN_CHAR = '<';
 	const char Task::MESSAGE_END_CHAR = '>';
@@ -485,18 +3751,44 @@ namespace EasyMPI
 	{
 		this->command = "";
 		this->parameters = "";
+		this->epoch = 0;
+		this->taskID = -1;
 	}
 
 	Task::Task(string command)
 	{
 		this->command = command;
 		this->parameters = "";
+		this->epoch = 0;
+		this->taskID = -1;
 	}
 
 	Task::Task(string command, string parameters)
 	{
 		this->command = command;
 		this->parameters = parameters;
+		this->epoch = 0;
+		this->taskID = -1;
+	}
+
+	Task::Task(string command, const FileRegion& region)
+	{
+		stringstream fileIDSS, offsetSS, lengthSS;
+		fileIDSS << region.fileID;
+		offsetSS << region.offset;
+		lengthSS << region.length;
+
+		// FILEREGION,fileID,offset,length
+		vector<string> paramList;
+		paramList.push_back(FILE_REGION_PARAMETER);
+		paramList.push_back(fileIDSS.str());
+		paramList.push_back(offsetSS.str());
+		paramList.push_back(lengthSS.str());
+
+		this->command = command;
+		this->parameters = ParameterTools::constructParameterString(paramList);
+		this->epoch = 0;
+		this->taskID = -1;
 	}
 
 	string Task::getCommand() const
@@ -509,17 +3801,57 @@ namespace EasyMPI
 		return this->parameters;
 	}
 
+	int Task::getEpoch() const
+	{
+		return this->epoch;
+	}
+
+	void Task::setEpoch(int epoch)
+	{
+		this->epoch = epoch;
+	}
+
+	int Task::getTaskID() const
+	{
+		return this->taskID;
+	}
+
+	void Task::setTaskID(int taskID)
+	{
+		this->taskID = taskID;
+	}
+
 	bool Task::isEmpty() const
 	{
 		return this->command.compare("") == 0 && this->parameters.compare("");
 	}
 
+	bool Task::isFileRegion() const
+	{
+		return getFileRegion().fileID >= 0;
+	}
+
+	FileRegion Task::getFileRegion() const
+	{
+		FileRegion region;
+
+		vector<string> paramList = ParameterTools::parseParameterString(this->parameters);
+		if (paramList.size() != 4 || paramList[0].compare(FILE_REGION_PARAMETER) != 0)
+			return region;
+
+		region.fileID = atoi(paramList[1].c_str());
+		region.offset = strtoull(paramList[2].c_str(), NULL, 10);
+		region.length = strtoull(paramList[3].c_str(), NULL, 10);
+
+		return region;
+	}
+
 	string Task::constructFullMessage(Task task)
 	{
 		string command = task.getCommand();
 		string parameters = task.getParameters();
 
-		// size<commandstring;parameterstring>XXX...
+		// size<commandstring;parameterstring;epoch;taskID>XXX...
 		// number of characters for size is MESSAGE_SIZE_NUM_CHARS
 
 		// sanity check
@@ -536,10 +3868,17 @@ namespace EasyMPI
 			MPIScheduler::abortMPI(1);
 		}
 
+		// convert epoch and task ID to string
+		stringstream epochSS, taskIDSS;
+		epochSS << task.getEpoch();
+		taskIDSS << task.getTaskID();
+
 		// calculate size of full message
 		int commandLength = command.length();
 		int messageLength = parameters.length();
-		int size = MESSAGE_SIZE_NUM_CHARS + 1 + commandLength + 1 + messageLength + 1;
+		int epochLength = epochSS.str().length();
+		int taskIDLength = taskIDSS.str().length();
+		int size = MESSAGE_SIZE_NUM_CHARS + 1 + commandLength + 1 + messageLength + 1 + epochLength + 1 + taskIDLength + 1;
 
 		if (size > MPIScheduler::MAX_MESSAGE_SIZE)
 		{
@@ -553,7 +3892,7 @@ namespace EasyMPI
 
 		// construct full message
 		stringstream ss;
-		ss << sizeSS.str() << MESSAGE_BEGIN_CHAR << command << MESSAGE_DELIMITER << parameters << MESSAGE_END_CHAR;
+		ss << sizeSS.str() << MESSAGE_BEGIN_CHAR << command << MESSAGE_DELIMITER << parameters << MESSAGE_DELIMITER << epochSS.str() << MESSAGE_DELIMITER << taskIDSS.str() << MESSAGE_END_CHAR;
 		stringstream messageSS;
 		messageSS << std::left << setfill('X') << setw(MPIScheduler::MAX_MESSAGE_SIZE) << ss.str();
 
@@ -564,9 +3903,11 @@ namespace EasyMPI
 	{
 		string command;
 		string parameters;
+		string epoch;
+		string taskID;
 		Task task;
 
-		// size<commandstring;parameterstring>XXX...
+		// size<commandstring;parameterstring;epoch;taskID>XXX...
 		// number of characters for size is MESSAGE_SIZE_NUM_CHARS
 
 		// get full message size
@@ -586,13 +3927,203 @@ namespace EasyMPI
 		stringstream ss(line);
 		getline(ss, command, MESSAGE_DELIMITER);
 		getline(ss, parameters, MESSAGE_DELIMITER);
+		getline(ss, epoch, MESSAGE_DELIMITER);
+		getline(ss, taskID, MESSAGE_DELIMITER);
 		task = Task(command, parameters);
+		task.setEpoch(atoi(epoch.c_str()));
+		task.setTaskID(taskID.empty() ? -1 : atoi(taskID.c_str()));
 
 		return task;
 	}
 
 
 
+	/*** TaskRing ***/
+
+	const unsigned int TaskRing::CAPACITY = 16;
+
+	TaskRing::TaskRing() : slots(CAPACITY), head(0), tail(0)
+	{
+	}
+
+	bool TaskRing::push(const Task& task)
+	{
+		const unsigned int tail = this->tail.load(std::memory_order_relaxed);
+		if (tail - this->head.load(std::memory_order_acquire) == CAPACITY)
+			return false;
+
+		// publish the slot only after it is written
+		this->slots[tail % CAPACITY] = task;
+		this->tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool TaskRing::pop(Task& task)
+	{
+		const unsigned int head = this->head.load(std::memory_order_relaxed);
+		if (head == this->tail.load(std::memory_order_acquire))
+			return false;
+
+		// free the slot only after it is read
+		task = this->slots[head % CAPACITY];
+		this->head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	void TaskRing::backoff(int& numPolls)
+	{
+		// short waits are common between a task and its reply, long ones while a task runs
+		if (++numPolls < 64)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+
+
+
+	/*** CompressionTools ***/
+
+	const int CompressionTools::MIN_MATCH_LENGTH = 4;
+	const int CompressionTools::MAX_OFFSET = 65535;
+	const int CompressionTools::HASH_BITS = 16;
+
+	void CompressionTools::compress(const char* data, size_t length, vector<char>& encoded)
+	{
+		// LZ77 byte format (similar to LZ4 blocks), a list of sequences:
+		// token, [literal length bytes], literals, offset (2 bytes), [match length bytes]
+		// the high nibble of the token is the literal length, the low nibble the match length - MIN_MATCH_LENGTH;
+		// a nibble of 15 is followed by bytes that are added to it until a byte is not 255.
+		// The last sequence only has literals.
+		encoded.clear();
+		encoded.reserve(length + length / 255 + 16);
+
+		vector<int> hashTable(1 << HASH_BITS, -1); // last position of each hashed 4-byte sequence
+		size_t anchor = 0; // start of pending literals
+		size_t position = 0;
+
+		while (position + MIN_MATCH_LENGTH <= length)
+		{
+			unsigned int sequence = read32(data + position);
+			unsigned int hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+			int candidate = hashTable[hash];
+			hashTable[hash] = (int)position;
+
+			if (candidate >= 0 && position - candidate <= (size_t)MAX_OFFSET && read32(data + candidate) == sequence)
+			{
+				// extend the match
+				size_t matchLength = MIN_MATCH_LENGTH;
+				while (position + matchLength < length && data[candidate + matchLength] == data[position + matchLength])
+					matchLength++;
+
+				writeSequence(data + anchor, position - anchor, position - candidate, matchLength, encoded);
+				position += matchLength;
+				anchor = position;
+			}
+			else
+			{
+				position++;
+			}
+		}
+
+		// remaining literals
+		writeSequence(data + anchor, length - anchor, 0, 0, encoded);
+	}
+
+	bool CompressionTools::decompress(const char* encoded, size_t encodedLength, char* data, size_t length)
+	{
+		const unsigned char* in = reinterpret_cast<const unsigned char*>(encoded);
+		size_t inPosition = 0;
+		size_t outPosition = 0;
+
+		while (inPosition < encodedLength)
+		{
+			unsigned char token = in[inPosition++];
+
+			// literals
+			size_t literalLength = token >> 4;
+			if (literalLength == 15 && !readLength(in, encodedLength, inPosition, literalLength))
+				return false;
+			if (literalLength > encodedLength - inPosition || literalLength > length - outPosition)
+				return false;
+			memcpy(data + outPosition, in + inPosition, literalLength);
+			inPosition += literalLength;
+			outPosition += literalLength;
+
+			// the last sequence has no match
+			if (inPosition == encodedLength)
+				break;
+
+			// match
+			if (encodedLength - inPosition < 2)
+				return false;
+			size_t offset = in[inPosition] | (in[inPosition+1] << 8);
+			inPosition += 2;
+			size_t matchLength = token & 15;
+			if (matchLength == 15 && !readLength(in, encodedLength, inPosition, matchLength))
+				return false;
+			matchLength += MIN_MATCH_LENGTH;
+			if (offset == 0 || offset > outPosition || matchLength > length - outPosition)
+				return false;
+
+			// byte by byte since the match may overlap its own output
+			for (size_t i = 0; i < matchLength; i++, outPosition++)
+				data[outPosition] = data[outPosition - offset];
+		}
+
+		return outPosition == length;
+	}
+
+	unsigned int CompressionTools::read32(const char* data)
+	{
+		unsigned int value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	void CompressionTools::writeSequence(const char* literals, size_t literalLength, size_t offset, size_t matchLength, vector<char>& encoded)
+	{
+		size_t matchCode = matchLength > 0 ? matchLength - MIN_MATCH_LENGTH : 0;
+		unsigned char token = (unsigned char)(((literalLength < 15 ? literalLength : 15) << 4) | (matchCode < 15 ? matchCode : 15));
+		encoded.push_back(token);
+
+		if (literalLength >= 15)
+			writeLength(literalLength - 15, encoded);
+		encoded.insert(encoded.end(), literals, literals + literalLength);
+
+		if (matchLength > 0)
+		{
+			encoded.push_back((char)(offset & 0xFF));
+			encoded.push_back((char)(offset >> 8));
+			if (matchCode >= 15)
+				writeLength(matchCode - 15, encoded);
+		}
+	}
+
+	void CompressionTools::writeLength(size_t length, vector<char>& encoded)
+	{
+		while (length >= 255)
+		{
+			encoded.push_back((char)255);
+			length -= 255;
+		}
+		encoded.push_back((char)length);
+	}
+
+	bool CompressionTools::readLength(const unsigned char* encoded, size_t encodedLength, size_t& position, size_t& length)
+	{
+		while (true)
+		{
+			if (position >= encodedLength)
+				return false;
+			unsigned char byte = encoded[position++];
+			length += byte;
+			if (byte != 255)
+				return true;
+		}
+	}
+
+
+
 	/*** ParameterTools ***/
 
 	const char ParameterTools::PARAMETER_DELIMITER = ',';
@@ -5,6 +5,11 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <queue>
+#include <deque>
+#include <map>
+#include <atomic>
+#include <thread>
 
 namespace EasyMPI
 {
@@ -12,8 +17,101 @@ namespace EasyMPI
 
 	// Forward class declarations
 	class MPIScheduler;
+	class MPISession;
+	class MPIPipeline;
+	class MessageTransport;
+	class MappedFiles;
+	class ResultCache;
+	class TaskRing;
+	class TaskQueues;
 	class Task;
 	class ParameterTools;
+	class CompressionTools;
+
+	/*!
+	 * User-supplied function that combines two accumulators: inout = combine(in, inout).
+	 * Used to reduce per-slave partial results (histograms, counters, top-k lists, ...).
+	 *
+	 * @param[in] in Accumulator to fold in
+	 * @param[in,out] inout Accumulator that receives the combined result
+	 * @param[in] length Number of values in each accumulator
+	 */
+	typedef void (*CombineFunction)(const double* in, double* inout, int length);
+
+	/*!
+	 * User-supplied function that processes the index range [begin, end) of a parallel for loop.
+	 *
+	 * @param[in] begin First index of the range
+	 * @param[in] end One past the last index of the range
+	 */
+	typedef void (*RangeFunction)(long long begin, long long end);
+
+	/*!
+	 * User-supplied function the master calls whenever a slave finished a task of a session. 
+	 * New tasks may be submitted to the session from this function.
+	 *
+	 * @param[in] session Session the task belongs to
+	 * @param[in] taskID ID of the task returned by MPISession::submit()
+	 * @param[in] task Task that was finished
+	 */
+	typedef void (*TaskFinishedCallback)(MPISession& session, int taskID, const Task& task);
+
+	/*!
+	 * User-supplied slave loop: wait for tasks with MPIScheduler::slaveWaitForTasks() 
+	 * until the MASTER_FINISH_COMMAND. Runs on threads when there is only one process 
+	 * (see MPIScheduler::setSlaveFunction()).
+	 */
+	typedef void (*SlaveFunction)();
+
+	/*!
+	 * User-supplied function that processes an item of a pipeline stage. 
+	 * Outputs for the next stage are passed on with MPIPipeline::emit().
+	 *
+	 * @param[in] pipeline Pipeline the item belongs to
+	 * @param[in] item Item to process (may contain binary data)
+	 */
+	typedef void (*StageFunction)(MPIPipeline& pipeline, const string& item);
+
+	/*!
+	 * Capabilities a worker (slave) process advertises at startup 
+	 * and the speed the master measured for it.
+	 */
+	struct WorkerInfo
+	{
+		int cores; //!< Number of hardware threads
+		long long memoryMB; //!< Physical memory in MB
+		vector<string> tags; //!< Tags from the EASYMPI_WORKER_TAGS environment variable
+		string binding; //!< CPU and NUMA node the worker is bound to ("none" if unbound)
+		double taskSpeed; //!< Smoothed task cost per second (0 until measured)
+		double rangeSpeed; //!< Smoothed parallelFor indices per second (0 until measured)
+		int numTasks; //!< Number of tasks finished
+		MPI_Comm comm; //!< Communicator the master reaches the worker on (MPI_COMM_WORLD or the intercommunicator of a spawned group)
+		int rank; //!< Rank of the worker in comm
+		bool active; //!< Whether the worker is attached (spawned workers are detached when retired)
+		bool thread; //!< Whether the worker is a slave thread of the master process (rank is then its thread index)
+
+		WorkerInfo() : cores(0), memoryMB(0), binding("none"), taskSpeed(0), rangeSpeed(0), numTasks(0), comm(MPI_COMM_NULL), rank(-1), active(false), thread(false) {}
+
+		/*!
+		 * Returns whether the worker has a tag. Every worker has the empty tag.
+		 */
+		bool hasTag(string tag) const;
+	};
+
+	/*!
+	 * A region of a file registered with MPIScheduler::masterRegisterFile(). 
+	 * Sent as a task with Task(command, region); MPIScheduler::mapFileRegion() 
+	 * maps the file on the slave and points data at the first byte of the region.
+	 */
+	struct FileRegion
+	{
+		int fileID; //!< ID of the file
+		size_t offset; //!< First byte of the region
+		size_t length; //!< Number of bytes of the region
+		const char* data; //!< Mapped bytes of the region (NULL until mapped)
+
+		FileRegion() : fileID(-1), offset(0), length(0), data(NULL) {}
+	};
 
 	/*!
 	 * MPIScheduler is a class that implements basic high level parallelism functionality. 
@@ -32,18 +130,48 @@ namespace EasyMPI
 	 *	getProcessID()
 	 *	getNumProcesses()
 	 *
-	 * Note that if the number of processes is 1, then this architecture fails. 
-	 * Simply have logic to perform tasks with only one process (included in Demo.cpp).
+	 * Loops over an integer range do not need tasks at all: 
+	 * every process simply calls parallelFor().
+	 *
+	 * Large read-only data needed by every task (a config, lookup table or model) 
+	 * can be published once by the master with masterPublishData() and read 
+	 * by any task handler with getSharedData().
+	 *
+	 * Per-task results that are summed or merged can be folded into a local 
+	 * accumulator on each slave with slaveFinishedTask(partialResult) after 
+	 * registering a combine function with setReduction(). The accumulators 
+	 * are reduced to the master at the end of every batch (getReducedResult()).
+	 *
+	 * To schedule many batches of tasks without shutting the slaves down 
+	 * in between, use an MPISession on the master instead of masterScheduleTasks().
+	 *
+	 * With setElasticScaling(), a session spawns extra workers (MPI_Comm_spawn) 
+	 * while the backlog is large and retires them when it has drained. 
+	 * Spawned workers run the same program and get worker IDs from getNumProcesses() up.
+	 *
+	 * If the number of processes is 1, the master runs the slave loop registered with 
+	 * setSlaveFunction() on threads instead, one per core, and talks to them through 
+	 * lock-free queues (included in Demo.cpp). Without a slave function this architecture 
+	 * fails, so have logic to perform tasks with only one process.
 	 *
 	 * Simply include the header file in your program to use these functions. 
 	 * Make sure MPI is installed on your system.
 	 */
 	class MPIScheduler
 	{
+		friend class MPISession;
+		friend class MessageTransport;
+
 	public:
 		const static int MAX_MESSAGE_SIZE; //!< Maximum message size
 		const static int MAX_NUM_PROCESSES; //!< Maximum number of processes
 		const static string MASTER_FINISH_COMMAND; //!< Master finished command
+		const static string MASTER_BATCH_FINISH_COMMAND; //!< Master finished batch command (sessions only)
+		const static string MASTER_PUBLISH_COMMAND; //!< Master publishing shared data command (handled internally)
+		const static string MASTER_CANCEL_COMMAND; //!< Master cancelled task command (handled internally)
+		const static string WORKER_TAGS_VARIABLE; //!< Environment variable with comma-separated tags of a worker
+		const static string AFFINITY_VARIABLE; //!< Environment variable with the CPU affinity policy (compact, scatter, or a CPU list like 0,2,4-7)
+		const static double SPEED_SMOOTHING; //!< Weight of the newest sample in the worker speed estimates
 		const static string SLAVE_FINISH_COMMAND; //!< Slave finished command
 		const static string SYNCHRONIZATION_MASTER_MESSAGE; //!< Master synchronization message
 		const static string SYNCHRONIZATION_SLAVE_MESSAGE; //!< Slave synchronization message
@@ -55,6 +183,100 @@ namespace EasyMPI
 		static bool finalized; //!< Whether called MPI finalized
 		static MPI_Status* mpiStatus; //!< MPI Status object
 		static int syncCounter; //!< counter of synchronization calls
+		static map<string, string> sharedData; //!< Published shared data by name
+		const static string REDUCE_PARAMETER; //!< Parameter of finish commands that asks slaves to reduce
+		const static int RANGE_TAG; //!< Message tag used by parallelFor()
+		static bool reductionEnabled; //!< Whether a reduction was registered
+		static vector<double> reductionIdentity; //!< Initial (identity) accumulator
+		static thread_local vector<double> reductionAccumulator; //!< Local accumulator of partial results (one per slave thread)
+		static vector<double> reducedResult; //!< Reduced result of the last batch (master)
+		static size_t compressionThreshold; //!< Payloads of at least this many bytes are compressed (0 to disable)
+		static vector<char> compressionBuffer; //!< Reusable buffer for compressed payloads
+
+		/*!
+		 * Counters for the compression statistics.
+		 */
+		struct CompressionStatistics
+		{
+			long long numMessages; //!< Number of compressed payloads
+			long long rawBytes; //!< Bytes before compression
+			long long encodedBytes; //!< Bytes after compression
+			double compressionSeconds; //!< Time spent compressing
+			double decompressionSeconds; //!< Time spent decompressing
+
+			CompressionStatistics() : numMessages(0), rawBytes(0), encodedBytes(0), compressionSeconds(0), decompressionSeconds(0) {}
+		};
+		static CompressionStatistics compressionStatistics; //!< Compression statistics of this process
+		static vector<WorkerInfo> workers; //!< Capabilities and speed of every process (master only)
+		static bool speedAware; //!< Whether to use the worker speeds for scheduling
+		static MPI_Comm masterComm; //!< Communicator a slave reaches the master on (MPI_COMM_WORLD or the parent intercommunicator)
+		static bool spawned; //!< Whether this process was spawned by the master
+		static vector<MPI_Comm> spawnedGroups; //!< Intercommunicators of the attached spawned groups (master only)
+		const static int SPAWN_TAG; //!< Message tag used to set up spawned workers
+		const static int WORKER_INFO_SIZE; //!< Size of the capabilities message of a worker
+		static vector<string> programArguments; //!< Command line of the program, used to spawn workers
+
+		/*!
+		 * Settings of the elastic worker pool.
+		 */
+		struct ElasticScaling
+		{
+			int maxSpawnedWorkers; //!< Maximum number of spawned workers attached at once (0 to disable)
+			int workersPerSpawn; //!< Number of workers spawned at once
+			double growBacklogPerWorker; //!< Grow when the waiting tasks per worker reach this
+			double growDrainSeconds; //!< Grow when the backlog would take the current workers at least this long
+			double retireIdleSeconds; //!< Retire a spawned group once all of its workers have been idle this long
+			string command; //!< Program the spawned workers run
+
+			ElasticScaling() : maxSpawnedWorkers(0), workersPerSpawn(1), growBacklogPerWorker(4), growDrainSeconds(1), retireIdleSeconds(1) {}
+		};
+		static ElasticScaling elastic; //!< Settings of the elastic worker pool
+		const static string FILE_TABLE_NAME; //!< Name of the shared data that holds the registered file paths
+		static vector<string> filePaths; //!< Registered file paths, by file ID
+		static thread_local MappedFiles mappedFiles; //!< Files mapped by this process (or slave thread)
+		const static string WRITE_PARAMETER; //!< Parameter of finish commands that asks slaves to write their results
+		static string outputPath; //!< File the results are written to (empty if disabled)
+		static long long outputSize; //!< Bytes of results in the file so far (master only)
+
+		/*!
+		 * Result of a task that is buffered until the end of the batch.
+		 */
+		struct BufferedResult
+		{
+			int taskID; //!< ID of the task
+			size_t position; //!< Position of the result in resultBuffer
+			size_t length; //!< Length of the result
+		};
+		static thread_local vector<BufferedResult> bufferedResults; //!< Results of this slave in the current batch
+		static thread_local vector<char> resultBuffer; //!< Bytes of the buffered results
+		static thread_local int currentTaskID; //!< ID of the task the slave is working on (-1 if none)
+		static thread_local size_t currentResultLength; //!< Bytes of results written for the current task
+		static thread_local int currentEpoch; //!< Epoch of the task the slave is working on
+		static thread_local bool currentTaskCancelled; //!< Whether the master cancelled the current task
+		const static int CANCEL_TAG; //!< Message tag of task cancellations
+		static ResultCache resultCache; //!< Memoized results of tasks
+		static vector<int> affinityCPUs; //!< CPUs in the order of the affinity policy, one per slot (empty if unbound)
+		static vector<int> cpuNodes; //!< NUMA node of every CPU
+		static thread_local int boundCPU; //!< CPU this process or slave thread is bound to (-1 if unbound)
+		static thread_local string currentTaskText; //!< Command and parameters of the current task (only if the cache is used)
+		static thread_local vector<double> currentPartialResult; //!< Partial result of the current task (only if the cache is used)
+		static MPI_Request slaveCancelRequest; //!< Persistent request of cancellations from the master (always started)
+		static vector<char> slaveCancelBuffer; //!< Receive buffer of slaveCancelRequest
+
+		struct ThreadWorker;
+		static SlaveFunction slaveFunction; //!< Slave loop run on threads when there is only one process
+		static int numSlaveThreads; //!< Number of slave threads (0 for one per core)
+		static int threadSupport; //!< Thread support level MPI provides (threads other than the main thread need MPI_THREAD_FUNNELED)
+		static vector<ThreadWorker*> threadWorkers; //!< Running slave threads by worker ID (NULL for other workers)
+		static thread_local int threadWorkerID; //!< Worker ID of this slave thread (0 if this is not a slave thread)
+		static MPI_Request slaveSendRequest; //!< Persistent request of slave messages to the master
+		static MPI_Request slaveRecvRequest; //!< Persistent request of master messages to the slave
+		static vector<char> slaveSendBuffer; //!< Send buffer of slaveSendRequest
+		static vector<char> slaveRecvBuffer; //!< Receive buffer of slaveRecvRequest
+
+		static CombineFunction reductionCombine; //!< User combine function
+		static MPI_Op reductionOp; //!< MPI operation wrapping the combine function
+		static MPI_Datatype reductionType; //!< MPI type holding a whole accumulator
 
 	public:
 		/*!
@@ -73,7 +295,7 @@ namespace EasyMPI
 		static void abortMPI(int errcode);
 
 		/*!
-		 * Get the process ID (rank).
+		 * Get the process ID (rank). Slave threads get their worker ID.
 		 */
 		static int getProcessID();
 
@@ -87,6 +309,35 @@ namespace EasyMPI
 		 */
 		static MPI_Status* getMPIStatus();
 
+		/*!
+		 * Master process gets the number of attached workers, including spawned ones.
+		 */
+		static int getNumWorkers();
+
+		/*!
+		 * Master process gets the IDs of the attached workers, including spawned ones.
+		 */
+		static vector<int> getWorkerIDs();
+
+		/*!
+		 * Returns whether this process was spawned by the master to grow the worker pool.
+		 */
+		static bool isSpawnedWorker();
+
+		/*!
+		 * Register the slave loop. If there is only one process, every MPISession (and 
+		 * masterScheduleTasks()) runs it on threads that get the tasks through lock-free 
+		 * queues instead of MPI messages, so the same master and slave code uses all cores. 
+		 * Slaves of more than one process ignore it and run their loop as usual.
+		 *
+		 * The slave code must be thread-safe. Slave threads must not call MPI themselves; 
+		 * the EasyMPI slave functions are safe to use.
+		 *
+		 * @param[in] function Slave loop (NULL to disable the threads)
+		 * @param[in] numThreads Number of slave threads, also used by a single-process parallelFor() (0 for one per core)
+		 */
+		static void setSlaveFunction(SlaveFunction function, int numThreads = 0);
+
 		/*!
 		 * Master process schedules tasks (command, parameters) to slaves.
 		 * Exits when all tasks have been completed.
@@ -108,12 +359,233 @@ namespace EasyMPI
 		 */
 		static void slaveFinishedTask();
 
+		/*!
+		 * Slave process folds the partial result of the recent task into its local 
+		 * accumulator and tells master that it is finished with the task.
+		 * Requires setReduction().
+		 *
+		 * @param[in] partialResult Partial result with as many values as the identity
+		 */
+		static void slaveFinishedTask(const vector<double>& partialResult);
+
+		/*!
+		 * Memoize task results in a directory. Must be called with the same arguments on every 
+		 * process before scheduling tasks. The master then finishes every task whose 
+		 * command and parameters match an earlier task itself, from the written result and 
+		 * the partial result stored by the slave that ran it, without sending it to a slave. 
+		 * Only use it for tasks whose result depends on nothing but the command and parameters. 
+		 * File region tasks are the exception: they are identified by the path, size and 
+		 * modification time of their file instead of the file ID, so a replaced or edited file 
+		 * misses the cache (a file rewritten within the same second with the same size does not). 
+		 * The directory must be shared by the master and the slaves (e.g. a node-local 
+		 * directory when all processes run on one node).
+		 *
+		 * @param[in] directory Directory of the cache (empty to disable)
+		 * @param[in] maxBytes Maximum total size of the cache
+		 */
+		static void setResultCache(string directory, long long maxBytes = 1LL << 30);
+
+		/*!
+		 * Slave process checks whether the master cancelled the task it is working on 
+		 * (see MPISession::cancel()). Cheap enough to poll often: it only tests a preposted 
+		 * receive. A cancelled handler should stop early and call slaveFinishedTask() as usual.
+		 *
+		 * @return Whether the current task was cancelled
+		 */
+		static bool isCancelled();
+
+		/*!
+		 * Register a reduction of per-slave partial results. 
+		 * Must be called with the same arguments on every process before scheduling tasks.
+		 *
+		 * At the end of every batch (and of masterScheduleTasks()), the accumulators 
+		 * of all slaves are reduced to the master with MPI_Reduce and reset to the identity. 
+		 * Non-commutative combine functions are applied in this order: the accumulator of the 
+		 * master (the partial results of cached tasks and of spawned groups retired during the 
+		 * batch, in the order they finished), the slaves started by mpirun in rank order, the 
+		 * spawned groups in the order they were spawned, then the slave threads. Since tasks 
+		 * go to whichever slave is free, combine should not depend on the order of tasks.
+		 *
+		 * @param[in] identity Initial accumulator, e.g. all zeros for a sum
+		 * @param[in] combine Function that combines two accumulators
+		 * @param[in] commutative Whether combine is commutative
+		 */
+		static void setReduction(vector<double> identity, CombineFunction combine, bool commutative = true);
+
+		/*!
+		 * Master process gets the reduced result of the most recent batch.
+		 */
+		static vector<double> getReducedResult();
+
+		/*!
+		 * Process the index range [begin, end) in parallel. Must be called by every process.
+		 * The master hands out sub-ranges of about grain indices to the slaves, 
+		 * which call function on each sub-range. Returns when the whole range is done.
+		 *
+		 * If the number of processes is 1, the range is processed by as many threads as 
+		 * setSlaveFunction() sets (one per core by default), the calling thread included, 
+		 * so function must be thread-safe. Without thread support in MPI the calling 
+		 * thread processes it alone.
+		 *
+		 * @param[in] begin First index
+		 * @param[in] end One past the last index
+		 * @param[in] grain Number of indices per sub-range (0 to choose automatically)
+		 * @param[in] function Function to call on each sub-range
+		 */
+		static void parallelFor(long long begin, long long end, long long grain, RangeFunction function);
+
 		/*!
 		 * All processes must reach this point before continuing. 
 		 * Useful command if need to synchronize all processes.
 		 */
 		static void synchronize();
 
+		/*!
+		 * Master process publishes named read-only data to all slaves using MPI_Bcast. 
+		 * Must be called while the slaves are waiting for tasks, i.e. before 
+		 * masterScheduleTasks() or between batches of an MPISession. 
+		 * Slaves receive the data inside slaveWaitForTasks().
+		 *
+		 * Publishing the same name again only broadcasts the range of bytes that changed.
+		 * Names may not include the ';' or ',' symbols!
+		 *
+		 * @param[in] name Name of the data
+		 * @param[in] data Data to publish (may contain binary data)
+		 */
+		static void masterPublishData(string name, const string& data);
+
+		/*!
+		 * Returns whether data was published under the name.
+		 *
+		 * @param[in] name Name of the data
+		 */
+		static bool hasSharedData(string name);
+
+		/*!
+		 * Get published data without copying it. Can be used from any task handler.
+		 * Returns an empty string if nothing was published under the name.
+		 *
+		 * @param[in] name Name of the data
+		 * @return Reference to the local copy of the data
+		 */
+		static const string& getSharedData(string name);
+
+		/*!
+		 * Master process gets the capabilities and measured speed of a process.
+		 *
+		 * @param[in] processID Process ID of the worker
+		 */
+		static WorkerInfo getWorkerInfo(int processID);
+
+		/*!
+		 * Set whether the master uses the measured worker speeds for scheduling (default is false). 
+		 * If so, idle faster slaves get tasks first, a slow slave leaves the last tasks to faster 
+		 * slaves that would finish them sooner, and parallelFor() gives bigger sub-ranges to faster slaves.
+		 */
+		static void setSpeedAwareScheduling(bool enabled);
+
+		/*!
+		 * Set the size from which published data is compressed before it is broadcast. 
+		 * Data that does not get smaller is sent uncompressed. Default is 64 KB.
+		 *
+		 * @param[in] threshold Minimum number of bytes to compress (0 to disable compression)
+		 */
+		static void setCompressionThreshold(size_t threshold);
+
+		/*!
+		 * Print the statistics of this process, e.g. compression ratio and throughput.
+		 *
+		 * @param[in] out Stream to print to
+		 */
+		static void printStatistics(ostream& out = cout);
+
+		/*!
+		 * Let sessions grow the worker pool with MPI_Comm_spawn while the backlog is large 
+		 * and retire the spawned workers once it has drained. Must be called on the master.
+		 *
+		 * The pool grows by workersPerSpawn workers whenever the waiting tasks per worker reach 
+		 * growBacklogPerWorker and the measured speeds say the backlog would take at least 
+		 * growDrainSeconds. A spawned group is retired once the backlog has drained and all 
+		 * of its workers have been idle for retireIdleSeconds, so a short lull between 
+		 * bursts does not tear it down. Spawned workers run the same slave loop as the others 
+		 * and get all published data when they join. parallelFor() and synchronize() only 
+		 * use the processes started by mpirun, so the program must skip them on spawned 
+		 * workers (see isSpawnedWorker()).
+		 *
+		 * @param[in] maxSpawnedWorkers Maximum number of spawned workers attached at once (0 to disable)
+		 * @param[in] workersPerSpawn Number of workers spawned at once
+		 * @param[in] growBacklogPerWorker Minimum number of waiting tasks per worker to grow
+		 * @param[in] growDrainSeconds Minimum estimated time to drain the backlog to grow
+		 * @param[in] retireIdleSeconds Minimum time all workers of a spawned group are idle to retire it
+		 * @param[in] command Program the workers run (empty for this program and its arguments)
+		 */
+		static void setElasticScaling(int maxSpawnedWorkers, int workersPerSpawn = 1, double growBacklogPerWorker = 4.0, double growDrainSeconds = 1.0, double retireIdleSeconds = 1.0, string command = "");
+
+		/*!
+		 * Master process registers a file that region tasks refer to by ID. The table of 
+		 * file paths is published as shared data, so this must be called while the slaves 
+		 * are waiting for tasks. Every process must be able to open the path.
+		 *
+		 * @param[in] path Path of the file
+		 * @return ID of the file (the same ID if the path was registered before)
+		 */
+		static int masterRegisterFile(string path);
+
+		/*!
+		 * Master process splits a file into region tasks of about regionSize bytes. 
+		 * Every region but the last is extended to end right after a record delimiter, 
+		 * so no record is split between two tasks.
+		 *
+		 * @param[in] command Command of the tasks
+		 * @param[in] path Path of the file (registered if needed)
+		 * @param[in] regionSize Target number of bytes per region
+		 * @param[in] recordDelimiter Last byte of every record
+		 * @return Tasks, one per region
+		 */
+		static vector<Task> masterSplitFile(string command, string path, size_t regionSize, char recordDelimiter = '\n');
+
+		/*!
+		 * Map the file region of a task into memory without copying it. 
+		 * Files stay mapped in a per-process cache, so later regions of the same 
+		 * file are free to map; the region itself is prefetched (readahead).
+		 *
+		 * region.data stays valid until MappedFiles::MAX_MAPPED_FILES other files 
+		 * have been mapped or finalize() is called.
+		 *
+		 * @param[in] task Task built with Task(command, region)
+		 * @param[out] region Region of the task with data pointing at its first byte
+		 * @return Whether the region could be mapped
+		 */
+		static bool mapFileRegion(const Task& task, FileRegion& region);
+
+		/*!
+		 * Returns the path of a registered file, or an empty string if there is none.
+		 *
+		 * @param[in] fileID ID of the file
+		 */
+		static string getFilePath(int fileID);
+
+		/*!
+		 * Master process sets the file that slaves write their results to with slaveWriteResult(). 
+		 * At the end of every batch the results are written in task order, after the results 
+		 * of the previous batches, with collective MPI-IO: the master broadcasts the offsets 
+		 * (a prefix sum of the result sizes) and every slave writes its own results directly 
+		 * into the file. The file is replaced.
+		 *
+		 * While the output is enabled, spawned workers stay attached until the session is closed.
+		 *
+		 * @param[in] path Path of the file (empty to disable)
+		 */
+		static void setOrderedOutput(string path);
+
+		/*!
+		 * Slave process appends to the result of the current task. 
+		 * The result is buffered locally and written at the end of the batch (see setOrderedOutput()).
+		 *
+		 * @param[in] result Bytes to append (may contain binary data)
+		 */
+		static void slaveWriteResult(const string& result);
+
 	private:
 		/*!
 		 * All processes must reach this point before continuing.
@@ -146,77 +618,1237 @@ namespace EasyMPI
 		 * @param[in] masterBroadcastMsg Message to broadcast to master
 		 */
 		static void slavesWait(string masterBroadcastMsg);
-	};
 
-	/*!
-	 * The Task class encapsulates a command that is sent and received as messages.
-	 * A Task consists of a command string and an optional parameter string, where the user can 
-	 * add any additional information for the command in the parameter string.
-	 *
-	 * The Task class also has utilities to convert to a message and back.
-	 *
-	 */
-	class Task
-	{
-	public:
-		const static char MESSAGE_DELIMITER; //!< Delimiter to delimit command and parameters
-		const static char MESSAGE_BEGIN_CHAR; //!< Begin message character
-		const static char MESSAGE_END_CHAR; //!< End message character
-		const static char MESSAGE_SIZE_NUM_CHARS; //!< Number of characters to represent size of message
+		/*!
+		 * Slave process receives data published by the master.
+		 *
+		 * @param[in] task Publish command from the master
+		 */
+		static void slaveReceivePublishedData(Task task);
 
-	protected:
-		string command; //!< Command string
-		string parameters; //!< Optional string of command parameters
+		/*!
+		 * Master process sends published data to some workers.
+		 *
+		 * @param[in] name Name of the data
+		 * @param[in] offset First byte to send
+		 * @param[in] length Number of bytes to send
+		 * @param[in] workerIDs Workers to send to: all workers of MPI_COMM_WORLD or none, plus whole spawned groups
+		 */
+		static void sendPublishedData(string name, size_t offset, size_t length, const vector<int>& workerIDs);
 
-	public:
 		/*!
-		 * Construct an empty task.
-		 * Do not use the empty task!
+		 * Broadcast a buffer from the master in pieces that fit in an int count.
+		 *
+		 * @param[in,out] buffer Buffer to broadcast into
+		 * @param[in] length Length of buffer
+		 * @param[in] comm Communicator to broadcast on
+		 * @param[in] root Root of the broadcast (MPI_ROOT on the master side of an intercommunicator)
 		 */
-		Task();
+		static void broadcastBuffer(char* buffer, size_t length, MPI_Comm comm, int root);
 
 		/*!
-		 * Construct a task. 
-		 * Commands may not include the semicolon ';' (MESSAGE_DELIMITER) symbol!
+		 * Reduce the accumulators of all processes to the master 
+		 * and reset the local accumulator.
 		 */
-		Task(string command);
-		
+		static void reduceAccumulators();
+
 		/*!
-		 * Construct a task. 
-		 * Commands and parameters may not include the semicolon ';' (MESSAGE_DELIMITER) symbol!
+		 * Master process folds the accumulators of a spawned group into its own accumulator, 
+		 * which is part of the next reduction.
+		 *
+		 * @param[in] group Intercommunicator of the group
 		 */
-		Task(string command, string parameters);
+		static void reduceGroupAccumulators(MPI_Comm group);
 
 		/*!
-		 * Returns the command.
+		 * MPI_User_function that applies the combine function to whole accumulators.
 		 */
-		string getCommand() const;
+		static void reductionOpFunction(void* in, void* inout, int* len, MPI_Datatype*);
 
 		/*!
-		 * Returns the parameters.
+		 * Master process broadcasts the offsets of the results of a batch 
+		 * and takes part in writing them.
+		 *
+		 * @param[in] resultSizes Size of the result of every task, by task ID
 		 */
-		string getParameters() const;
+		static void writeOrderedOutput(const vector<long long>& resultSizes);
 
 		/*!
-		 * Returns if the command and parameters are empty strings.
+		 * Slave process receives the offsets of the results of a batch and writes its results.
 		 */
-		bool isEmpty() const;
+		static void slaveWriteOrderedOutput();
 
 		/*!
-		 * Construct message for message passing.
+		 * Write the buffered results of this process into the output file with a collective write.
 		 *
-		 * @param[in] task Task object
-		 * @return Message string
+		 * @param[in] comm Communicator of the processes that write together
+		 * @param[in] path Path of the file
+		 * @param[in] fileSize Size to set the file to (-1 to leave it)
+		 * @param[in] offsets Offset of the result of every task in the file, by task ID
 		 */
-		static string constructFullMessage(Task task);
+		static void writeResultBuffer(MPI_Comm comm, string path, long long fileSize, const vector<long long>& offsets);
 
 		/*!
-		 * Parse message from message passing.
+		 * Every process advertises its capabilities to the master.
+		 */
+		static void gatherWorkerInfo();
+
+		/*!
+		 * Capabilities of this process: cores,memory,binding,tag1,tag2,...
+		 */
+		static string describeWorker();
+
+		/*!
+		 * Parse the capabilities a worker advertised.
 		 *
-		 * @param[in] message Message string
-		 * @return Task object
+		 * @param[in] info Capabilities from describeWorker()
+		 * @param[out] worker Worker to fill in
 		 */
-		static Task parseFullMessage(string message);
+		static void parseWorkerInfo(string info, WorkerInfo& worker);
+
+		/*!
+		 * A spawned process gets its worker ID from the master and advertises its capabilities.
+		 */
+		static void joinParent();
+
+		/*!
+		 * Read the affinity policy from AFFINITY_VARIABLE and bind this process to the CPU 
+		 * of its slot. Slots are numbered per node so that the master gets the first CPU 
+		 * to itself. Binding happens before any buffers are allocated, so they are placed 
+		 * on the local NUMA node when first touched.
+		 *
+		 * @param[in] slot Slot of this process (node-local rank, or worker ID if spawned)
+		 */
+		static void setUpAffinity(int slot);
+
+		/*!
+		 * Returns the CPU of a slot, or -1 if no affinity policy is set. Slots past the 
+		 * last CPU wrap around the CPUs after the first, so they never share the master's CPU.
+		 *
+		 * @param[in] slot Slot of a process or thread
+		 */
+		static int getSlotCPU(int slot);
+
+		/*!
+		 * Bind the calling thread to the CPU of a slot (see getSlotCPU()) if an affinity policy is set.
+		 *
+		 * @param[in] slot Slot of the thread
+		 */
+		static void bindToSlot(int slot);
+
+		/*!
+		 * Returns a CPU and its NUMA node as text, or "none" for -1 (unbound).
+		 */
+		static string describeBinding(int cpu);
+
+		/*!
+		 * Master process spawns a group of workers and brings them up to date with the published data.
+		 *
+		 * @param[in] count Number of workers to spawn
+		 * @return Worker IDs of the new workers (empty if spawning failed)
+		 */
+		static vector<int> spawnWorkers(int count);
+
+		/*!
+		 * Master process starts the slave threads and adds them as workers.
+		 */
+		static void startThreadWorkers();
+
+		/*!
+		 * Returns the number of slave threads set with setSlaveFunction(), or one per core 
+		 * (less the master's core if it is bound) if none was set.
+		 */
+		static int getNumSlaveThreads();
+
+		/*!
+		 * Master process waits for the slave threads, which were sent the finish command.
+		 */
+		static void stopThreadWorkers();
+
+		/*!
+		 * Body of a slave thread.
+		 *
+		 * @param[in] workerID Worker ID of the thread
+		 */
+		static void runThreadWorker(int workerID);
+
+		/*!
+		 * slaveWaitForTasks() of a slave thread.
+		 */
+		static Task threadWaitForTasks();
+
+		/*!
+		 * Returns a key that identifies a task across batches.
+		 *
+		 * @param[in] epoch Epoch of the batch
+		 * @param[in] taskID ID of the task within the batch
+		 */
+		static long long taskKey(int epoch, int taskID);
+
+		/*!
+		 * Master process detaches a spawned group that was sent the finish command.
+		 *
+		 * @param[in] group Intercommunicator of the group
+		 */
+		static void disconnectGroup(MPI_Comm group);
+
+		/*!
+		 * Fold a new sample into a smoothed speed estimate.
+		 *
+		 * @param[in,out] speed Speed estimate (0 if none yet)
+		 * @param[in] sample Measured speed
+		 */
+		static void updateSpeed(double& speed, double sample);
+
+		/*!
+		 * Create the persistent requests a slave uses to talk to the master.
+		 */
+		static void slaveInitRequests();
+
+		/*!
+		 * Free the persistent requests of a slave.
+		 */
+		static void slaveFreeRequests();
+
+		/*!
+		 * Master side of parallelFor(): hand out sub-ranges to slaves.
+		 */
+		static void masterScheduleRange(long long begin, long long end, long long grain);
+
+		/*!
+		 * Size of the next sub-range for a slave: the grain, scaled by the 
+		 * speed of the slave relative to the others if it is known.
+		 */
+		static long long rangeChunkSize(int slaveID, long long grain);
+
+		/*!
+		 * Slave side of parallelFor(): process sub-ranges until the master is done.
+		 */
+		static void slaveProcessRanges(RangeFunction function);
+
+		/*!
+		 * parallelFor() with one process: process sub-ranges with local threads.
+		 */
+		static void threadProcessRange(long long begin, long long end, long long grain, RangeFunction function);
+	};
+
+	/*!
+	 * MessageTransport sends task messages from the master to the slaves and receives 
+	 * their replies with persistent MPI requests, so message envelopes are set up once 
+	 * per slave and reused for every message.
+	 *
+	 * Every slave has a send, a receive and a cancellation buffer of MAX_MESSAGE_SIZE in a pooled arena. 
+	 * Sends are non-blocking, so sends to different slaves overlap; a slave's send buffer 
+	 * is only reused once its previous send completed. The receive for the reply of a 
+	 * slave is preposted when a message that expects a reply is sent to it.
+	 *
+	 * Slaves are indexed by worker ID. Workers spawned later are added with addWorker(); 
+	 * the arena grows in slabs so the buffers of existing requests never move.
+	 *
+	 * Slave threads (see MPIScheduler::setSlaveFunction()) get their messages 
+	 * through a pair of TaskRing queues instead.
+	 */
+	class MessageTransport
+	{
+	public:
+		const static int TIMED_OUT; //!< Returned by waitForReply() when the timeout passed
+
+	private:
+		const static int SLAB_SIZE; //!< Number of workers per arena slab
+		vector< vector<char> > slabs; //!< Arena of send and receive buffers, SLAB_SIZE workers per slab
+		vector<MPI_Request> sendRequests; //!< Persistent send request of each worker
+		vector<MPI_Request> recvRequests; //!< Persistent receive request of each worker
+		vector<MPI_Request> pendingRequests; //!< Requests queued to start on the next flush()
+		vector<MPI_Request> cancelRequests; //!< Non-blocking send of the last cancellation to each worker
+		vector<bool> threadReplyExpected; //!< Whether a reply of each slave thread is expected
+		int numThreadRepliesExpected; //!< Number of replies expected from slave threads
+
+	public:
+		/*!
+		 * Set up the persistent requests for every attached worker.
+		 */
+		MessageTransport();
+
+		/*!
+		 * Wait for all sends and free the persistent requests.
+		 */
+		~MessageTransport();
+
+		/*!
+		 * Set up the persistent requests for a worker.
+		 *
+		 * @param[in] workerID Worker ID of the slave
+		 */
+		void addWorker(int workerID);
+
+		/*!
+		 * Wait for the last send to a worker and free its persistent requests. 
+		 * No reply from the worker may be outstanding.
+		 *
+		 * @param[in] workerID Worker ID of the slave
+		 */
+		void removeWorker(int workerID);
+
+		/*!
+		 * Queue a message to a slave. Queued messages are started by flush().
+		 *
+		 * @param[in] slaveID Process ID of the slave
+		 * @param[in] task Message to send
+		 * @param[in] expectReply Whether to prepost the receive for the reply of the slave
+		 */
+		void send(int slaveID, Task task, bool expectReply);
+
+		/*!
+		 * Start all queued messages at once (MPI_Startall).
+		 */
+		void flush();
+
+		/*!
+		 * Tell a slave right away that its task was cancelled. The message bypasses 
+		 * the task messages, so it reaches a slave that is busy with the task.
+		 *
+		 * @param[in] slaveID Process ID of the slave
+		 * @param[in] task Cancel command with the epoch and ID of the task
+		 */
+		void sendCancel(int slaveID, Task task);
+
+		/*!
+		 * Block until a reply from any slave arrives.
+		 *
+		 * @param[out] task Reply received
+		 * @param[in] timeoutSeconds Give up after this long (negative to wait for ever)
+		 * @return Process ID of the slave, -1 if no reply is expected, or TIMED_OUT
+		 */
+		int waitForReply(Task& task, double timeoutSeconds = -1);
+
+		/*!
+		 * Block until all sends completed.
+		 */
+		void waitForSends();
+
+	private:
+		/*!
+		 * Send buffer of a worker.
+		 */
+		char* sendBuffer(int workerID);
+
+		/*!
+		 * Receive buffer of a worker.
+		 */
+		char* recvBuffer(int workerID);
+
+		/*!
+		 * Cancellation buffer of a worker.
+		 */
+		char* cancelBuffer(int workerID);
+
+		MessageTransport(const MessageTransport&);
+		MessageTransport& operator=(const MessageTransport&);
+	};
+
+	/*!
+	 * MappedFiles is a cache of read-only memory-mapped files of a process, by file ID. 
+	 * Files are mapped whole on first use and unmapped least recently used first 
+	 * once more than MAX_MAPPED_FILES are mapped.
+	 */
+	class MappedFiles
+	{
+	public:
+		const static int MAX_MAPPED_FILES; //!< Maximum number of files mapped at once
+
+	private:
+		/*!
+		 * A mapped file.
+		 */
+		struct MappedFile
+		{
+			const char* data; //!< First byte of the mapping
+			size_t size; //!< Size of the file
+			long long lastUse; //!< Value of useCounter when the file was last used
+			void* fileHandle; //!< Handle of the file (Windows only)
+			void* mappingHandle; //!< Handle of the file mapping (Windows only)
+		};
+		map<int, MappedFile> files; //!< Mapped files by file ID
+		long long useCounter; //!< Counts the uses of files
+
+	public:
+		MappedFiles();
+
+		/*!
+		 * Unmap all files.
+		 */
+		~MappedFiles();
+
+		/*!
+		 * Map a whole file for sequential reading, or get the existing mapping.
+		 *
+		 * @param[in] fileID ID of the file
+		 * @param[in] path Path of the file
+		 * @param[out] size Size of the file
+		 * @return First byte of the file, or NULL if it could not be mapped
+		 */
+		const char* mapFile(int fileID, string path, size_t& size);
+
+		/*!
+		 * Ask the operating system to read a region of a mapped file ahead.
+		 *
+		 * @param[in] data First byte of the mapped file
+		 * @param[in] offset First byte of the region
+		 * @param[in] length Number of bytes of the region
+		 */
+		void advise(const char* data, size_t offset, size_t length);
+
+		/*!
+		 * Unmap all files.
+		 */
+		void unmapAll();
+
+	private:
+		/*!
+		 * Unmap a file.
+		 */
+		void unmap(MappedFile& file);
+
+		MappedFiles(const MappedFiles&);
+		MappedFiles& operator=(const MappedFiles&);
+	};
+
+	/*!
+	 * ResultCache memoizes the results of tasks in a directory, one file per task, 
+	 * named by a hash of the command and parameters of the task. The result of a task 
+	 * is what its slave wrote with MPIScheduler::slaveWriteResult() and its partial result.
+	 *
+	 * Slaves store the entries; the master looks them up and keeps the directory 
+	 * below its size limit by removing the least recently used entries.
+	 */
+	class ResultCache
+	{
+	private:
+		/*!
+		 * An entry in the directory.
+		 */
+		struct Entry
+		{
+			long long size; //!< Size of the file
+			long long lastUse; //!< Value of useCounter when the entry was last used
+		};
+		string directory; //!< Directory of the entries (empty if disabled)
+		long long maxBytes; //!< Maximum total size of the entries
+		map<string, Entry> entries; //!< Entries by file name (master only)
+		long long totalBytes; //!< Total size of the entries
+		long long useCounter; //!< Counts the uses of entries
+		long long numHits; //!< Number of tasks found in the cache
+		long long numMisses; //!< Number of tasks not found in the cache
+		long long numStored; //!< Number of entries recorded
+		long long numEvicted; //!< Number of entries removed
+
+	public:
+		ResultCache();
+
+		/*!
+		 * Use a directory for the cache and index the entries already in it. 
+		 * The entries found are used oldest first.
+		 *
+		 * @param[in] directory Directory of the entries (created if needed; empty to disable)
+		 * @param[in] maxBytes Maximum total size of the entries
+		 */
+		void open(string directory, long long maxBytes);
+
+		/*!
+		 * Returns whether the cache is used.
+		 */
+		bool isEnabled() const;
+
+		/*!
+		 * Master process checks whether there is an entry for a task.
+		 */
+		bool contains(const Task& task) const;
+
+		/*!
+		 * Master process reads the entry of a task.
+		 *
+		 * @param[in] task Task to look up
+		 * @param[out] result Result the slave wrote
+		 * @param[out] partialResult Partial result of the task (empty if none)
+		 * @return Whether the entry exists and belongs to the task
+		 */
+		bool load(const Task& task, string& result, vector<double>& partialResult);
+
+		/*!
+		 * Slave stores the result of a task. The entry is written to a temporary 
+		 * file and renamed, so the master never reads a partial entry.
+		 *
+		 * @param[in] taskText Command and parameters of the task (see encode())
+		 * @param[in] result First byte of the result
+		 * @param[in] length Length of the result
+		 * @param[in] partialResult Partial result of the task (empty if none)
+		 */
+		void store(const string& taskText, const char* result, size_t length, const vector<double>& partialResult) const;
+
+		/*!
+		 * Master process indexes the entry a slave stored for a task and 
+		 * removes the least recently used entries while the cache is too large.
+		 */
+		void record(const Task& task);
+
+		/*!
+		 * Master process counts a task that was not found.
+		 */
+		void countMiss();
+
+		/*!
+		 * Print the hits, misses and size of the cache.
+		 *
+		 * @param[in] out Stream to print to
+		 */
+		void printStatistics(ostream& out) const;
+
+		/*!
+		 * Returns the command and parameters of a task, which identify its result. 
+		 * File region tasks are identified by the path, size and modification time of 
+		 * their file instead of the file ID. Returns an empty string for tasks that 
+		 * cannot be cached (their file is unknown or missing).
+		 */
+		static string encode(const Task& task);
+
+	private:
+		/*!
+		 * Returns the file name of the entry of a task (64-bit FNV-1a hash in hex).
+		 */
+		static string fileName(const string& taskText);
+
+		/*!
+		 * Remove the least recently used entries while the cache is too large.
+		 */
+		void evict();
+
+		ResultCache(const ResultCache&);
+		ResultCache& operator=(const ResultCache&);
+	};
+
+	/*!
+	 * TaskQueues holds the tasks waiting for a slave in named task classes. 
+	 * Classes with a higher priority are always served first. Classes of the same 
+	 * priority share the slaves in proportion to their weights. A class with a 
+	 * maximum wait time is served next whenever its oldest task waited longer than that, 
+	 * so low priority classes do not starve.
+	 *
+	 * Wait times (from submission until a task is handed to a slave) are recorded per class.
+	 */
+	class TaskQueues
+	{
+	public:
+		const static string DEFAULT_CLASS; //!< Name of the class that always exists
+		const static double DEFAULT_MAX_WAIT_SECONDS; //!< Wait after which a class is served regardless of priority, unless set otherwise
+
+	private:
+		/*!
+		 * A task waiting in a queue.
+		 */
+		struct WaitingTask
+		{
+			int taskID; //!< ID of the task
+			double submitTime; //!< Time the task was submitted
+			string requiredTag; //!< Tag a worker needs to get the task (empty for any)
+		};
+
+		/*!
+		 * A named queue of waiting tasks.
+		 */
+		struct TaskClass
+		{
+			string name; //!< Name of the class
+			int priority; //!< Higher priorities are served first
+			double weight; //!< Share of the slaves among classes of the same priority
+			double maxWaitSeconds; //!< Serve the class when its oldest task waited longer (0 for no limit)
+			deque<WaitingTask> waiting; //!< Waiting tasks in submission order
+			double virtualTime; //!< Number of tasks served divided by the weight
+			vector<double> waitTimes; //!< Wait time of every served task
+		};
+
+		vector<TaskClass> classes; //!< All task classes
+		int numWaiting; //!< Number of waiting tasks of all classes
+
+	public:
+		/*!
+		 * Construct queues with only the default class (priority 0, weight 1, DEFAULT_MAX_WAIT_SECONDS).
+		 */
+		TaskQueues();
+
+		/*!
+		 * Add a task class, or change it if it already exists.
+		 *
+		 * @param[in] name Name of the class
+		 * @param[in] priority Higher priorities are served first
+		 * @param[in] weight Share of the slaves among classes of the same priority
+		 * @param[in] maxWaitSeconds Serve the class when its oldest task waited longer (0 for no limit)
+		 */
+		void addClass(string name, int priority, double weight, double maxWaitSeconds);
+
+		/*!
+		 * Add a waiting task to a class.
+		 *
+		 * @param[in] taskID ID of the task
+		 * @param[in] className Name of the class
+		 * @param[in] requiredTag Tag a worker needs to get the task (empty for any)
+		 */
+		void push(int taskID, string className, string requiredTag = "");
+
+		/*!
+		 * Find the next task to serve to a worker without removing it.
+		 *
+		 * @param[in] worker Worker that would get the task
+		 * @param[out] classIndex Class of the task
+		 * @param[out] position Position of the task in its class
+		 * @return ID of the task, or -1 if no task is waiting for this worker
+		 */
+		int peek(const WorkerInfo& worker, int& classIndex, int& position) const;
+
+		/*!
+		 * Remove a task found by peek().
+		 *
+		 * @param[in] classIndex Class of the task
+		 * @param[in] position Position of the task in its class
+		 */
+		void take(int classIndex, int position);
+
+		/*!
+		 * Remove the next task to serve to a worker.
+		 *
+		 * @param[in] worker Worker that gets the task
+		 * @return ID of the task, or -1 if no task is waiting for this worker
+		 */
+		int pop(const WorkerInfo& worker);
+
+		/*!
+		 * Remove a waiting task without serving it.
+		 *
+		 * @param[in] taskID ID of the task
+		 * @return Whether the task was waiting
+		 */
+		bool remove(int taskID);
+
+		/*!
+		 * Remove all waiting tasks without serving them.
+		 *
+		 * @return IDs of the removed tasks
+		 */
+		vector<int> clear();
+
+		/*!
+		 * Returns whether no task is waiting.
+		 */
+		bool empty() const;
+
+		/*!
+		 * Returns the number of waiting tasks.
+		 */
+		int size() const;
+
+		/*!
+		 * Print the number of served tasks and wait-time percentiles of every class.
+		 *
+		 * @param[in] out Stream to print to
+		 */
+		void printStatistics(ostream& out) const;
+
+	private:
+		/*!
+		 * Returns the index of a class or -1 if it does not exist.
+		 */
+		int findClass(string name) const;
+
+		/*!
+		 * Returns the position of the oldest task of a class a worker can get, or -1 if there is none.
+		 */
+		int findEligible(const TaskClass& taskClass, const WorkerInfo& worker) const;
+	};
+
+	/*!
+	 * MPISession keeps the slaves attached to the master across many batches of tasks. 
+	 * Useful for iterative algorithms that schedule a batch of tasks per iteration.
+	 *
+	 * Every batch gets a new epoch number that is attached to each of its tasks. 
+	 * When a batch is complete, each slave receives a Task with the 
+	 * MASTER_BATCH_FINISH_COMMAND command (and the epoch of the finished batch) 
+	 * from slaveWaitForTasks() and should simply continue waiting for tasks. 
+	 * Closing the session sends the usual MASTER_FINISH_COMMAND to the slaves, 
+	 * so the slave loop only runs once for the whole session.
+	 *
+	 * Only the master process creates a session:
+	 *
+	 *	MPISession session;
+	 *	for (...)
+	 *		session.scheduleTasks(taskList);
+	 *	session.close();
+	 *
+	 * Tasks can also be submitted one by one to named task classes with priorities 
+	 * and fair-share weights (see TaskQueues) and run with scheduleTasks(). 
+	 * Submissions are accepted while a batch runs, e.g. from the TaskFinishedCallback.
+	 *
+	 * Searches that stop at the first solution cancel the rest of the batch with 
+	 * cancel() or cancelAll(): waiting tasks are dropped, and the slaves running 
+	 * a cancelled task see MPIScheduler::isCancelled() become true.
+	 */
+	class MPISession
+	{
+		friend class MPIScheduler;
+
+	private:
+		bool open; //!< Whether the slaves are still attached
+		int epoch; //!< Epoch of the most recent batch
+		bool reducePending; //!< Whether results of the most recent batch still need to be reduced
+		bool writePending; //!< Whether results of the most recent batch still need to be written
+		vector<int> processTask; //!< Task assigned to each process (-1 if none)
+		queue<int> availableProcesses; //!< Queue of available processes for work
+		MessageTransport transport; //!< Persistent requests to the slaves
+		TaskQueues queues; //!< Waiting tasks of the current batch
+		vector<Task> batchTasks; //!< Tasks submitted to the current batch, by task ID
+		vector<double> batchCosts; //!< Estimated cost of each task of the current batch
+		vector<string> batchTags; //!< Tag required by each task of the current batch
+		vector<double> dispatchTimes; //!< Time each process got its current task
+		double batchCostSum; //!< Total estimated cost of the tasks of the current batch
+		vector<long long> batchResultSizes; //!< Size of the written result of each task of the current batch
+		vector<bool> batchCancelled; //!< Whether each task of the current batch was cancelled
+		vector< pair<int, string> > cachedTasks; //!< Tasks of the current batch found in the result cache and not finished yet, with their task class
+		int numDroppedTasks; //!< Number of tasks of the current batch cancelled before they were assigned
+		vector<double> finishTimes; //!< Time each process finished its last task (or joined)
+		TaskFinishedCallback taskFinishedCallback; //!< Called when a slave finished a task
+
+	public:
+		/*!
+		 * Begin a session. Must be called by the master process.
+		 */
+		MPISession();
+
+		/*!
+		 * Closes the session if it is still open.
+		 */
+		~MPISession();
+
+		/*!
+		 * Schedule a batch of tasks to the slaves and notify them when the batch is finished.
+		 * Exits when all tasks of the batch have been completed.
+		 *
+		 * @param[in] taskList List of tasks to perform in parallel
+		 */
+		void scheduleTasks(vector<Task> taskList);
+
+		/*!
+		 * Schedule the submitted tasks as a batch and notify the slaves when the batch is finished.
+		 * Exits when all tasks of the batch, including those submitted while it runs, have been completed.
+		 */
+		void scheduleTasks();
+
+		/*!
+		 * Add a task class, or change it if it already exists. 
+		 * The class TaskQueues::DEFAULT_CLASS always exists with priority 0 and weight 1. 
+		 * Every class is protected from starvation by default: once its oldest task waited 
+		 * TaskQueues::DEFAULT_MAX_WAIT_SECONDS, it is served before higher priorities.
+		 *
+		 * @param[in] name Name of the class
+		 * @param[in] priority Higher priorities are served first
+		 * @param[in] weight Share of the slaves among classes of the same priority
+		 * @param[in] maxWaitSeconds Serve the class when its oldest task waited longer (0 for no limit)
+		 */
+		void addTaskClass(string name, int priority, double weight = 1.0, double maxWaitSeconds = TaskQueues::DEFAULT_MAX_WAIT_SECONDS);
+
+		/*!
+		 * Submit a task to the current batch. 
+		 * May be called while the batch runs, e.g. from the TaskFinishedCallback.
+		 *
+		 * The cost is an estimate of the work of the task relative to other tasks; 
+		 * it is used to measure the speed of each slave. 
+		 * A task with a required tag only goes to slaves that advertise the tag.
+		 *
+		 * @param[in] task Task to submit
+		 * @param[in] taskClass Name of the task class
+		 * @param[in] cost Estimated cost of the task
+		 * @param[in] requiredTag Tag a slave needs to get the task (empty for any slave)
+		 * @return ID of the task within the batch
+		 */
+		int submit(Task task, string taskClass = TaskQueues::DEFAULT_CLASS, double cost = 1.0, string requiredTag = "");
+
+		/*!
+		 * Set the function the master calls whenever a slave finished a task (NULL for none). 
+		 * It is not called for cancelled tasks.
+		 */
+		void setTaskFinishedCallback(TaskFinishedCallback callback);
+
+		/*!
+		 * Cancel a task of the current batch. A waiting task (or one found in the result cache 
+		 * and not finished yet) is dropped; the slave running the task is told without waiting 
+		 * for it, and the batch continues when it finished. The partial result of a cancelled 
+		 * task is not reduced, unless the slave finished the task before the notice arrived.
+		 *
+		 * @param[in] taskID ID of the task returned by submit()
+		 * @return Whether the task was waiting or running
+		 */
+		bool cancel(int taskID);
+
+		/*!
+		 * Cancel every waiting and running task of the current batch.
+		 *
+		 * @return Number of tasks cancelled
+		 */
+		int cancelAll();
+
+		/*!
+		 * Print the wait-time percentiles of every task class.
+		 *
+		 * @param[in] out Stream to print to
+		 */
+		void printStatistics(ostream& out = cout) const;
+
+		/*!
+		 * End the session by telling all slaves that the master is finished.
+		 */
+		void close();
+
+		/*!
+		 * Returns the epoch of the most recent batch (0 if none was scheduled yet).
+		 */
+		int getEpoch() const;
+
+		/*!
+		 * Returns whether the session is still open.
+		 */
+		bool isOpen() const;
+
+	private:
+		/*!
+		 * Run the submitted tasks until all tasks are completed.
+		 */
+		void runTasks();
+
+		/*!
+		 * Hand waiting tasks to available slaves.
+		 */
+		void assignWaitingTasks();
+
+		/*!
+		 * Finish the tasks found in the result cache on the master: buffer their results 
+		 * for the ordered output, fold their partial results and call the callback. 
+		 * Tasks the cache no longer has are queued for the slaves instead.
+		 *
+		 * @return Number of tasks finished
+		 */
+		int finishCachedTasks();
+
+		/*!
+		 * Returns whether a slave should leave a task to a faster busy slave 
+		 * that is expected to finish it sooner.
+		 *
+		 * @param[in] slaveID Process ID of the idle slave
+		 * @param[in] taskID ID of the task
+		 */
+		bool shouldLeaveToFasterSlave(int slaveID, int taskID) const;
+
+		/*!
+		 * Spawn workers while the backlog is large and retire idle spawned workers 
+		 * once it has drained (see MPIScheduler::setElasticScaling()).
+		 *
+		 * @param[in] numWaitingTasks Number of tasks still waiting for a slave
+		 * @return Seconds until an idle group is due to be retired, or -1 if none is
+		 */
+		double scaleWorkers(int numWaitingTasks);
+
+		/*!
+		 * Retire the spawned groups whose workers have all been idle for 
+		 * MPIScheduler::ElasticScaling::retireIdleSeconds since their last task.
+		 *
+		 * @return Seconds until the next idle group is due, or -1 if none is
+		 */
+		double retireIdleGroups();
+
+		/*!
+		 * Tell the workers of a spawned group to finish, fold in their partial 
+		 * results if a reduction is pending, and detach the group.
+		 *
+		 * @param[in] group Intercommunicator of the group
+		 */
+		void retireGroup(MPI_Comm group);
+
+		/*!
+		 * Assign a task to a slave by sending it a message.
+		 *
+		 * @param[in] slaveID Process ID of the slave
+		 * @param[in] task Task to send
+		 */
+		void assignTask(int slaveID, Task task);
+
+		/*!
+		 * Send a command to every slave.
+		 *
+		 * @param[in] task Command to send
+		 */
+		void notifySlaves(Task task);
+
+		/*!
+		 * Tell every slave that a batch or the session is finished, 
+		 * reduce the partial results and write the results if needed.
+		 *
+		 * @param[in] task Finish command to send
+		 */
+		void finishBatch(Task task);
+
+		MPISession(const MPISession&);
+		MPISession& operator=(const MPISession&);
+	};
+
+	/*!
+	 * MPIPipeline runs the stages of a streaming pipeline at the same time on separate groups 
+	 * of processes, e.g. decoding on some processes and computing on others. 
+	 *
+	 * The processes are split into consecutive stage groups, each with its own sub-communicator 
+	 * (getStageComm()). The first process of a group schedules the stage and the others are its 
+	 * workers. Process 0 schedules stage 0 and feeds the pipeline with submit(). A worker calls 
+	 * the stage function on every item it gets; items passed to emit() go straight to a worker 
+	 * of the next stage, without passing through process 0. 
+	 *
+	 * Every worker holds at most queueCapacity items that are waiting or being processed. 
+	 * A producer waits in submit() or emit() until the next stage has room (backpressure). 
+	 *
+	 * Every process constructs the pipeline, sets the stage functions and calls run():
+	 *
+	 *	MPIPipeline pipeline(stageSizes);
+	 *	pipeline.setStageFunction(0, decode);
+	 *	pipeline.setStageFunction(1, compute);
+	 *	if (MPIScheduler::getProcessID() == 0)
+	 *		for (...)
+	 *			pipeline.submit(item);
+	 *	pipeline.run();
+	 *
+	 * The pipeline is independent of masterScheduleTasks() and MPISession and runs once.
+	 */
+	class MPIPipeline
+	{
+	private:
+		const static int REQUEST_TAG; //!< Producer asks the scheduler of the next stage for room
+		const static int GRANT_TAG; //!< Scheduler tells a producer which worker gets its item
+		const static int DATA_TAG; //!< Item sent from a producer to a worker
+		const static int DONE_TAG; //!< Worker tells its scheduler it finished an item
+		const static int END_TAG; //!< Producer has no more items, or scheduler tells its workers to stop
+
+		vector<int> stageFirst; //!< First process of every stage (its scheduler), plus the number of processes
+		vector<StageFunction> stageFunctions; //!< Function of every stage
+		int queueCapacity; //!< Maximum number of items per worker
+		int stage; //!< Stage of this process
+		MPI_Comm pipelineComm; //!< Duplicate of MPI_COMM_WORLD for the pipeline messages
+		MPI_Comm stageComm; //!< Processes of the stage of this process
+		vector<int> outstanding; //!< Items granted to each worker of the stage and not yet done (scheduler only)
+		long long numItems; //!< Items processed (workers) or scheduled (schedulers)
+		long long numEmitted; //!< Items passed on to the next stage
+		double waitSeconds; //!< Time spent waiting for room in the next stage
+
+	public:
+		/*!
+		 * Split the processes into stage groups. Must be called by every process.
+		 *
+		 * @param[in] stageSizes Number of processes of every stage, including its scheduler; must add up to the number of processes
+		 * @param[in] queueCapacity Maximum number of items per worker
+		 */
+		MPIPipeline(const vector<int>& stageSizes, int queueCapacity = 4);
+
+		/*!
+		 * Frees the communicators if run() was not called.
+		 */
+		~MPIPipeline();
+
+		/*!
+		 * Set the function of a stage. Must be called with the same arguments on every process before run().
+		 *
+		 * @param[in] stage Stage number
+		 * @param[in] function Function that processes the items of the stage
+		 */
+		void setStageFunction(int stage, StageFunction function);
+
+		/*!
+		 * Process 0 feeds an item to stage 0. Blocks while stage 0 has no room.
+		 *
+		 * @param[in] item Item to process (may contain binary data)
+		 */
+		void submit(const string& item);
+
+		/*!
+		 * Pass an output of the current item on to the next stage. May only be called 
+		 * from a stage function of any stage but the last. Blocks while the next stage has no room.
+		 *
+		 * @param[in] item Item for the next stage (may contain binary data)
+		 */
+		void emit(const string& item);
+
+		/*!
+		 * Run the part of this process until all items went through the pipeline. 
+		 * Must be called by every process; on process 0 it ends the input.
+		 */
+		void run();
+
+		/*!
+		 * Returns the stage of this process.
+		 */
+		int getStage() const;
+
+		/*!
+		 * Returns whether this process schedules its stage.
+		 */
+		bool isStageScheduler() const;
+
+		/*!
+		 * Returns the communicator of the processes of this stage (valid until run() returns).
+		 */
+		MPI_Comm getStageComm() const;
+
+		/*!
+		 * Print the number of items and the time spent waiting for the next stage.
+		 *
+		 * @param[in] out Stream to print to
+		 */
+		void printStatistics(ostream& out = cout) const;
+
+	private:
+		/*!
+		 * Scheduler: grant room to producers and track the workers until the stage is done.
+		 *
+		 * @param[in] numProducers Number of producers that will send END_TAG
+		 */
+		void runScheduler(int numProducers);
+
+		/*!
+		 * Worker: process items until the scheduler ends the stage.
+		 */
+		void runWorker();
+
+		/*!
+		 * Scheduler: returns the least loaded worker with room, or -1 if there is none.
+		 */
+		int findWorkerWithRoom() const;
+
+		/*!
+		 * Scheduler: handle a DONE_TAG or END_TAG message.
+		 *
+		 * @param[in] status Status of the message
+		 * @param[in,out] numProducers Producers that did not end yet
+		 */
+		void handleMessage(const MPI_Status& status, int& numProducers);
+
+		/*!
+		 * Free the communicators.
+		 */
+		void freeCommunicators();
+
+		MPIPipeline(const MPIPipeline&);
+		MPIPipeline& operator=(const MPIPipeline&);
+	};
+
+	/*!
+	 * The Task class encapsulates a command that is sent and received as messages.
+	 * A Task consists of a command string and an optional parameter string, where the user can 
+	 * add any additional information for the command in the parameter string.
+	 *
+	 * The Task class also has utilities to convert to a message and back.
+	 *
+	 * Tasks scheduled through an MPISession also carry the epoch of their batch 
+	 * and their ID within the batch.
+	 *
+	 * A task can also refer to a region of a file instead of carrying text parameters 
+	 * (see FileRegion and MPIScheduler::mapFileRegion()).
+	 */
+	class Task
+	{
+	public:
+		const static string FILE_REGION_PARAMETER; //!< First parameter of file region tasks
+		const static char MESSAGE_DELIMITER; //!< Delimiter to delimit command and parameters
+		const static char MESSAGE_BEGIN_CHAR; //!< Begin message character
+		const static char MESSAGE_END_CHAR; //!< End message character
+		const static char MESSAGE_SIZE_NUM_CHARS; //!< Number of characters to represent size of message
+
+	protected:
+		string command; //!< Command string
+		string parameters; //!< Optional string of command parameters
+		int epoch; //!< Epoch of the batch this task belongs to (0 if none)
+		int taskID; //!< ID of the task within its batch (-1 if none)
+
+	public:
+		/*!
+		 * Construct an empty task.
+		 * Do not use the empty task!
+		 */
+		Task();
+
+		/*!
+		 * Construct a task. 
+		 * Commands may not include the semicolon ';' (MESSAGE_DELIMITER) symbol!
+		 */
+		Task(string command);
+		
+		/*!
+		 * Construct a task. 
+		 * Commands and parameters may not include the semicolon ';' (MESSAGE_DELIMITER) symbol!
+		 */
+		Task(string command, string parameters);
+
+		/*!
+		 * Construct a task that processes a region of a registered file.
+		 * Commands may not include the semicolon ';' (MESSAGE_DELIMITER) symbol!
+		 */
+		Task(string command, const FileRegion& region);
+
+		/*!
+		 * Returns the command.
+		 */
+		string getCommand() const;
+
+		/*!
+		 * Returns the parameters.
+		 */
+		string getParameters() const;
+
+		/*!
+		 * Returns the epoch of the batch this task belongs to (0 if none).
+		 */
+		int getEpoch() const;
+
+		/*!
+		 * Sets the epoch of the batch this task belongs to.
+		 */
+		void setEpoch(int epoch);
+
+		/*!
+		 * Returns the ID of the task within its batch (-1 if none).
+		 */
+		int getTaskID() const;
+
+		/*!
+		 * Sets the ID of the task within its batch.
+		 */
+		void setTaskID(int taskID);
+
+		/*!
+		 * Returns if the command and parameters are empty strings.
+		 */
+		bool isEmpty() const;
+
+		/*!
+		 * Returns whether the task refers to a file region.
+		 */
+		bool isFileRegion() const;
+
+		/*!
+		 * Returns the file region of the task (fileID is -1 if there is none). 
+		 * The region is not mapped; use MPIScheduler::mapFileRegion() for that.
+		 */
+		FileRegion getFileRegion() const;
+
+		/*!
+		 * Construct message for message passing.
+		 *
+		 * @param[in] task Task object
+		 * @return Message string
+		 */
+		static string constructFullMessage(Task task);
+
+		/*!
+		 * Parse message from message passing.
+		 *
+		 * @param[in] message Message string
+		 * @return Task object
+		 */
+		static Task parseFullMessage(string message);
+	};
+
+	/*!
+	 * TaskRing is a lock-free single-producer single-consumer queue of tasks. 
+	 * The master and a slave thread use a pair of them instead of MPI messages.
+	 */
+	class TaskRing
+	{
+	public:
+		const static unsigned int CAPACITY; //!< Maximum number of tasks in the queue
+
+	private:
+		vector<Task> slots; //!< Ring buffer of tasks
+		std::atomic<unsigned int> head; //!< Number of tasks popped (written by the consumer)
+		std::atomic<unsigned int> tail; //!< Number of tasks pushed (written by the producer)
+
+	public:
+		TaskRing();
+
+		/*!
+		 * Producer appends a task. Returns false if the queue is full.
+		 */
+		bool push(const Task& task);
+
+		/*!
+		 * Consumer takes the oldest task. Returns false if the queue is empty.
+		 */
+		bool pop(Task& task);
+
+		/*!
+		 * Wait a little between polls: yield at first, then sleep briefly.
+		 *
+		 * @param[in,out] numPolls Number of polls so far
+		 */
+		static void backoff(int& numPolls);
+
+	private:
+		TaskRing(const TaskRing&);
+		TaskRing& operator=(const TaskRing&);
+	};
+
+	/*!
+	 * CompressionTools is a small in-tree LZ77 codec (in the spirit of LZ4) 
+	 * used to compress large payloads before they are sent. 
+	 * It favors speed over compression ratio.
+	 */
+	class CompressionTools
+	{
+	public:
+		const static int MIN_MATCH_LENGTH; //!< Shortest match that is encoded
+		const static int MAX_OFFSET; //!< Farthest match that is encoded
+		const static int HASH_BITS; //!< Number of bits of the match finder hash table
+
+	public:
+		/*!
+		 * Compress data.
+		 *
+		 * @param[in] data Data to compress
+		 * @param[in] length Length of data
+		 * @param[out] encoded Compressed data (reuses its capacity)
+		 */
+		static void compress(const char* data, size_t length, vector<char>& encoded);
+
+		/*!
+		 * Decompress data.
+		 *
+		 * @param[in] encoded Compressed data
+		 * @param[in] encodedLength Length of compressed data
+		 * @param[out] data Buffer for the decompressed data
+		 * @param[in] length Length of the decompressed data
+		 * @return Whether the compressed data was valid
+		 */
+		static bool decompress(const char* encoded, size_t encodedLength, char* data, size_t length);
+
+	private:
+		/*!
+		 * Read 4 bytes from any alignment.
+		 */
+		static unsigned int read32(const char* data);
+
+		/*!
+		 * Append a sequence of literals followed by a match (none if matchLength is 0).
+		 */
+		static void writeSequence(const char* literals, size_t literalLength, size_t offset, size_t matchLength, vector<char>& encoded);
+
+		/*!
+		 * Append the extra bytes of a length.
+		 */
+		static void writeLength(size_t length, vector<char>& encoded);
+
+		/*!
+		 * Read the extra bytes of a length and add them to length.
+		 */
+		static bool readLength(const unsigned char* encoded, size_t encodedLength, size_t& position, size_t& length);
 	};
 
 	/*!